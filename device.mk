@@ -118,6 +118,7 @@ PRODUCT_PACKAGES += \
     disable_configstore
 
 # Dalvik
+# The heap is sized per RAM tier by libinit_raphael, this is the smallest tier.
 PRODUCT_PROPERTY_OVERRIDES += \
     dalvik.vm.dex2oat64.enabled=true \
     dalvik.vm.heapgrowthlimit=256m
@@ -215,16 +216,18 @@ PRODUCT_PACKAGES += \
 
 # Init
 PRODUCT_PACKAGES += \
-    init.qcom.post_boot.sh \
     init.qcom.rc \
     init.qcom.sh \
-    init.qti.dcvs.sh \
     init.raphael.rc \
     init.raphael.wlan.rc \
     init.recovery.qcom.rc \
     init.target.rc \
+    post_boot \
     ueventd.qcom.rc
 
+PRODUCT_COPY_FILES += \
+    $(LOCAL_PATH)/configs/post_boot/post_boot.conf:$(TARGET_COPY_OUT_VENDOR)/etc/post_boot.conf
+
 # IFAA manager
 PRODUCT_PACKAGES += \
     IFAAService
@@ -266,6 +269,10 @@ PRODUCT_PACKAGES += \
     libcodec2_soft_common.vendor \
     libsfplugin_ccodec_utils.vendor
 
+# Memory tuning
+PRODUCT_PACKAGES += \
+    memtune
+
 # Native Public Libraries
 PRODUCT_COPY_FILES += \
     $(LOCAL_PATH)/configs/public.libraries.txt:$(TARGET_COPY_OUT_VENDOR)/etc/public.libraries.txt
@@ -310,6 +317,10 @@ PRODUCT_COPY_FILES += \
 PRODUCT_PACKAGES += \
     android.hardware.power.stats@1.0-service.mock
 
+PRODUCT_COPY_FILES += \
+    $(LOCAL_PATH)/configs/power/power_app_profiles.conf:$(TARGET_COPY_OUT_VENDOR)/etc/power_app_profiles.conf \
+    $(LOCAL_PATH)/configs/power/power_profiles.conf:$(TARGET_COPY_OUT_VENDOR)/etc/power_profiles.conf
+
 # QTI
 PRODUCT_PACKAGES += \
     libjson
@@ -28,108 +28,366 @@
    IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <vector>
+#include <array>
+#include <string_view>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
-#include <android-base/properties.h>
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
 #include <sys/sysinfo.h>
 
-using android::base::GetProperty;
+namespace {
+
+// What vendor_load_properties costs in early init, exported as
+// ro.vendor.init.* once it is done. Phase times include their overrides.
+struct boot_stats {
+    uint64_t lookups;
+    uint64_t lookup_ns;
+    uint64_t added;
+    uint64_t updated;
+    uint64_t override_ns;
+    uint64_t sysinfo_ns;
+    uint64_t memory_class_ns;
+    uint64_t dex2oat_ns;
+    uint64_t total_ns;
+};
+
+boot_stats stats;
+
+uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
 void property_override(char const prop[], char const value[], bool add = true) {
     prop_info* pi;
+    uint64_t start = now_ns();
 
     pi = (prop_info*)__system_property_find(prop);
-    if (pi)
+    if (pi) {
         __system_property_update(pi, value, strlen(value));
-    else if (add)
+        stats.updated++;
+    } else if (add) {
         __system_property_add(prop, strlen(prop), value, strlen(value));
+        stats.added++;
+    }
+    stats.override_ns += now_ns() - start;
+}
+
+struct memory_class {
+    uint64_t max_ram_mb;
+    // Dalvik heap.
+    const char* heapstartsize;
+    const char* heapgrowthlimit;
+    const char* heapsize;
+    const char* heaptargetutilization;
+    const char* heapminfree;
+    const char* heapmaxfree;
+    // JIT code cache.
+    const char* jitinitialsize;
+    const char* jitmaxsize;
+    // lmkd.
+    const char* lmk_thrashing_limit;
+    const char* lmk_swap_free_low_percentage;
+    const char* lmk_psi_partial_stall_ms;
+    // zram, sized as a share of RAM.
+    uint64_t zram_percent;
+    const char* zram_comp_algorithm;
+    const char* zram_max_comp_streams;
+};
+
+// One profile per RAM tier, picked by the usable RAM the kernel reports.
+// The smallest tier keeps the stock heap with the ART JIT and lmkd defaults,
+// the larger ones get more heap and let lmkd wait longer before killing.
+constexpr memory_class memory_classes[] = {
+        // 4/6GB RAM
+        {7000, "16m", "256m", "512m", "0.5", "8m", "32m", "64k", "64m", "100", "10", "70", 50,
+         "lz4", "8"},
+        // 8GB RAM
+        {10000, "24m", "384m", "512m", "0.46", "8m", "48m", "128k", "64m", "125", "8", "100", 40,
+         "lz4", "8"},
+        // 12GB RAM
+        {UINT64_MAX, "32m", "512m", "768m", "0.42", "16m", "64m", "256k", "64m", "150", "5",
+         "150", 30, "zstd", "4"},
+};
+
+constexpr uint64_t zram_max_size = 4096ull * 1024 * 1024;
+
+const memory_class& find_memory_class(uint64_t ram_mb) {
+    for (const auto& mc : memory_classes) {
+        if (ram_mb < mc.max_ram_mb) return mc;
+    }
+    return memory_classes[0];
 }
 
-void load_dalvikvm_properties() {
+// Whether the zram driver offers the given compressor, e.g. "lzo [lz4] zstd".
+bool zram_has_algorithm(const char* algorithm) {
+    char algorithms[256] = "";
+    FILE* file = fopen("/sys/block/zram0/comp_algorithm", "re");
+    if (!file) return false;
+    size_t len = fread(algorithms, 1, sizeof(algorithms) - 1, file);
+    fclose(file);
+    algorithms[len] = '\0';
+
+    for (char* token = strtok(algorithms, " []\n"); token; token = strtok(nullptr, " []\n")) {
+        if (!strcmp(token, algorithm)) return true;
+    }
+    return false;
+}
+
+void load_memory_class_properties() {
     struct sysinfo sys;
+    uint64_t start = now_ns();
 
     sysinfo(&sys);
-    if (sys.totalram < 7000ull * 1024 * 1024) {
-        // 4/6GB RAM
-        property_override("dalvik.vm.heapstartsize", "16m");
-        property_override("dalvik.vm.heaptargetutilization", "0.5");
-        property_override("dalvik.vm.heapmaxfree", "32m");
-    } else {
-        // 8/12/16GB RAM
-        property_override("dalvik.vm.heapstartsize", "24m");
-        property_override("dalvik.vm.heaptargetutilization", "0.46");
-        property_override("dalvik.vm.heapmaxfree", "48m");
+    stats.sysinfo_ns = now_ns() - start;
+    uint64_t ram = static_cast<uint64_t>(sys.totalram) * sys.mem_unit;
+    const memory_class& mc = find_memory_class(ram / (1024 * 1024));
+
+    property_override("dalvik.vm.heapstartsize", mc.heapstartsize);
+    property_override("dalvik.vm.heapgrowthlimit", mc.heapgrowthlimit);
+    property_override("dalvik.vm.heapsize", mc.heapsize);
+    property_override("dalvik.vm.heaptargetutilization", mc.heaptargetutilization);
+    property_override("dalvik.vm.heapminfree", mc.heapminfree);
+    property_override("dalvik.vm.heapmaxfree", mc.heapmaxfree);
+
+    property_override("dalvik.vm.jitinitialsize", mc.jitinitialsize);
+    property_override("dalvik.vm.jitmaxsize", mc.jitmaxsize);
+
+    property_override("ro.lmk.thrashing_limit", mc.lmk_thrashing_limit);
+    property_override("ro.lmk.swap_free_low_percentage", mc.lmk_swap_free_low_percentage);
+    property_override("ro.lmk.psi_partial_stall_ms", mc.lmk_psi_partial_stall_ms);
+
+    // Consumed by init.target.rc right before swapon_all.
+    char zram_size[PROP_VALUE_MAX];
+    uint64_t size = ram * mc.zram_percent / 100;
+    if (size > zram_max_size) size = zram_max_size;
+    // Whole megabytes.
+    size &= ~static_cast<uint64_t>(1024 * 1024 - 1);
+    snprintf(zram_size, sizeof(zram_size), "%" PRIu64, size);
+    property_override("ro.vendor.zram.disksize", zram_size);
+    property_override("ro.vendor.zram.comp_algorithm",
+                      zram_has_algorithm(mc.zram_comp_algorithm) ? mc.zram_comp_algorithm : "lz4");
+    property_override("ro.vendor.zram.max_comp_streams", mc.zram_max_comp_streams);
+    stats.memory_class_ns = now_ns() - start;
+}
+
+constexpr int max_cpus = 16;
+
+int read_int(const char* path) {
+    int value = -1;
+    FILE* file = fopen(path, "re");
+    if (file) {
+        if (fscanf(file, "%d", &value) != 1) value = -1;
+        fclose(file);
     }
+    return value;
+}
 
-    property_override("dalvik.vm.heapgrowthlimit", "256m");
-    property_override("dalvik.vm.heapsize", "512m");
-    property_override("dalvik.vm.heapminfree", "8m");
+// Relative capacity of each CPU, from the scheduler or else from the
+// maximum frequency. Returns the number of CPUs.
+int read_cpu_capacities(int capacities[max_cpus]) {
+    char path[64];
+    int count = 0;
+    for (; count < max_cpus; count++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", count);
+        int capacity = read_int(path);
+        if (capacity <= 0) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq",
+                     count);
+            capacity = read_int(path);
+        }
+        if (capacity <= 0) break;
+        capacities[count] = capacity;
+    }
+    return count;
 }
 
-std::vector<std::string> ro_props_default_source_order = {
+void set_dex2oat_props(const char* kind, uint32_t cpus) {
+    char prop[64];
+    char value[PROP_VALUE_MAX] = "";
+    int threads = 0;
+
+    for (int cpu = 0; cpu < max_cpus; cpu++) {
+        if (!(cpus & (1u << cpu))) continue;
+        size_t len = strlen(value);
+        snprintf(value + len, sizeof(value) - len, "%s%d", threads ? "," : "", cpu);
+        threads++;
+    }
+    snprintf(prop, sizeof(prop), "dalvik.vm.%sdex2oat-cpu-set", kind);
+    property_override(prop, value);
+
+    snprintf(value, sizeof(value), "%d", threads);
+    snprintf(prop, sizeof(prop), "dalvik.vm.%sdex2oat-threads", kind);
+    property_override(prop, value);
+}
+
+// Boot time compilation has the whole SoC to itself. Installs use every
+// core but the prime one, which stays with the foreground app, and
+// background dexopt is kept to the little cores.
+void load_dex2oat_properties() {
+    int capacities[max_cpus];
+    uint64_t start = now_ns();
+    int count = read_cpu_capacities(capacities);
+    if (count == 0) return;
+
+    int min_capacity = capacities[0], max_capacity = capacities[0];
+    for (int cpu = 1; cpu < count; cpu++) {
+        if (capacities[cpu] < min_capacity) min_capacity = capacities[cpu];
+        if (capacities[cpu] > max_capacity) max_capacity = capacities[cpu];
+    }
+
+    uint32_t all = 0, little = 0, prime = 0;
+    for (int cpu = 0; cpu < count; cpu++) {
+        all |= 1u << cpu;
+        if (capacities[cpu] == min_capacity) little |= 1u << cpu;
+        if (capacities[cpu] == max_capacity) prime |= 1u << cpu;
+    }
+    // Only a small top cluster counts as prime, a symmetric SoC has none.
+    if (prime == all || __builtin_popcount(prime) * 2 > count) prime = 0;
+
+    set_dex2oat_props("boot-", all);
+    set_dex2oat_props("image-", all);
+    set_dex2oat_props("", all & ~prime);
+    set_dex2oat_props("background-", little);
+    stats.dex2oat_ns = now_ns() - start;
+}
+
+constexpr std::array<std::string_view, 7> ro_props_default_source_order = {
         "", "bootimage.", "odm.", "product.", "system.", "system_ext.", "vendor.",
 };
 
-void set_ro_build_prop(const std::string& prop, const std::string& value) {
-    for (const auto& source : ro_props_default_source_order) {
-        auto prop_name = "ro." + source + "build." + prop;
-        if (source == "")
-            property_override(prop_name.c_str(), value.c_str());
-        else
-            property_override(prop_name.c_str(), value.c_str(), false);
+// Property names are generated at compile time, so overriding them at boot
+// is a plain loop over static strings.
+using prop_name = std::array<char, PROP_NAME_MAX>;
+
+constexpr prop_name make_prop_name(std::string_view prefix, std::string_view source,
+                                   std::string_view prop) {
+    prop_name name{};
+    size_t i = 0;
+    for (auto part : {prefix, source, prop}) {
+        for (char c : part) name.at(i++) = c;
     }
-};
+    // Fails to compile when the name and its terminator don't fit.
+    name.at(i) = '\0';
+    return name;
+}
+
+constexpr std::array<prop_name, ro_props_default_source_order.size()> ro_product_prop_names(
+        std::string_view prop) {
+    std::array<prop_name, ro_props_default_source_order.size()> names{};
+    for (size_t i = 0; i < names.size(); i++) {
+        names[i] = make_prop_name("ro.product.", ro_props_default_source_order[i], prop);
+    }
+    return names;
+}
+
+constexpr auto ro_product_device_props = ro_product_prop_names("device");
+constexpr auto ro_product_model_props = ro_product_prop_names("model");
 
-void set_ro_product_prop(const std::string& prop, const std::string& value) {
-    for (const auto& source : ro_props_default_source_order) {
-        auto prop_name = "ro.product." + source + prop;
-        property_override(prop_name.c_str(), value.c_str(), false);
+template <size_t N>
+void set_ro_product_prop(const std::array<prop_name, N>& names, const char* value) {
+    for (const auto& name : names) {
+        property_override(name.data(), value, false);
     }
+}
+
+struct variant {
+    std::string_view region;
+    const char* model;
+    const char* device;
+    const char* description;
+    const char* mod_device;
 };
 
-void vendor_load_properties() {
-    std::string region;
-    std::string hardware_revision;
-    region = GetProperty("ro.boot.hwc", "GLOBAL");
-    hardware_revision = GetProperty("ro.boot.hwversion", "UNKNOWN");
-
-    std::string model;
-    std::string device;
-    std::string fingerprint;
-    std::string description;
-    std::string mod_device;
-
-    if (region == "GLOBAL") {
-        model = "Mi 9T Pro";
-        device = "raphael";
-        description = "raphael-user 11 RKQ1.200826.002 V12.5.2.0.RFKMIXM release-keys";
-        mod_device = "raphael_global";
-    } else if (region == "CN") {
-        model = "Redmi K20 Pro";
-        device = "raphael";
-        description = "raphael-user 11 RKQ1.200826.002 V12.5.5.0.RFKCNXM release-keys";
-    } else if (region == "INDIA") {
-        model = "Redmi K20 Pro";
-        device = "raphaelin";
-        description = "raphaelin-user 11 RKQ1.200826.002 V12.5.1.0.RFKINXM release-keys";
-        mod_device = "raphaelin_in_global";
+// The first entry is used for unknown regions.
+constexpr variant variants[] = {
+        {"GLOBAL", "Mi 9T Pro", "raphael",
+         "raphael-user 11 RKQ1.200826.002 V12.5.2.0.RFKMIXM release-keys", "raphael_global"},
+        {"CN", "Redmi K20 Pro", "raphael",
+         "raphael-user 11 RKQ1.200826.002 V12.5.5.0.RFKCNXM release-keys", nullptr},
+        {"INDIA", "Redmi K20 Pro", "raphaelin",
+         "raphaelin-user 11 RKQ1.200826.002 V12.5.1.0.RFKINXM release-keys",
+         "raphaelin_in_global"},
+};
+
+const variant& find_variant(std::string_view region) {
+    for (const auto& v : variants) {
+        if (v.region == region) return v;
     }
+    return variants[0];
+}
+
+void get_prop(const char* name, char value[PROP_VALUE_MAX], const char* default_value) {
+    uint64_t start = now_ns();
+
+    if (__system_property_get(name, value) <= 0) {
+        strlcpy(value, default_value, PROP_VALUE_MAX);
+    }
+    stats.lookups++;
+    stats.lookup_ns += now_ns() - start;
+}
+
+void publish_boot_stats() {
+    // Snapshot first, publishing goes through property_override as well.
+    const boot_stats s = stats;
+    const struct {
+        const char* name;
+        uint64_t value;
+    } values[] = {
+            {"ro.vendor.init.lookups", s.lookups},
+            {"ro.vendor.init.lookup_ns", s.lookup_ns},
+            {"ro.vendor.init.props_added", s.added},
+            {"ro.vendor.init.props_updated", s.updated},
+            {"ro.vendor.init.override_ns", s.override_ns},
+            {"ro.vendor.init.sysinfo_ns", s.sysinfo_ns},
+            {"ro.vendor.init.memory_class_ns", s.memory_class_ns},
+            {"ro.vendor.init.dex2oat_ns", s.dex2oat_ns},
+            {"ro.vendor.init.total_ns", s.total_ns},
+    };
+    char value[PROP_VALUE_MAX];
+
+    for (const auto& v : values) {
+        snprintf(value, sizeof(value), "%" PRIu64, v.value);
+        property_override(v.name, value);
+    }
+}
+
+}  // anonymous namespace
+
+void vendor_load_properties() {
+    uint64_t start = now_ns();
+    char region[PROP_VALUE_MAX];
+    char hardware_revision[PROP_VALUE_MAX];
+    get_prop("ro.boot.hwc", region, "GLOBAL");
+    get_prop("ro.boot.hwversion", hardware_revision, "UNKNOWN");
+
+    const variant& v = find_variant(region);
 
     property_override("ro.apex.updatable", "false");
 
-    set_ro_product_prop("device", device);
-    set_ro_product_prop("model", model);
-    property_override("ro.boot.hardware.sku", device.c_str());
-    property_override("ro.boot.product.hardware.sku", device.c_str());
-    property_override("ro.build.description", description.c_str());
-    if (mod_device != "") {
-        property_override("ro.product.mod_device", mod_device.c_str());
+    set_ro_product_prop(ro_product_device_props, v.device);
+    set_ro_product_prop(ro_product_model_props, v.model);
+    property_override("ro.boot.hardware.sku", v.device);
+    property_override("ro.boot.product.hardware.sku", v.device);
+    property_override("ro.build.description", v.description);
+    if (v.mod_device) {
+        property_override("ro.product.mod_device", v.mod_device);
     }
 
-    property_override("ro.boot.hardware.revision", hardware_revision.c_str());
+    property_override("ro.boot.hardware.revision", hardware_revision);
+
+    load_memory_class_properties();
+    load_dex2oat_properties();
 
-    load_dalvikvm_properties();
+    stats.total_ns = now_ns() - start;
+    publish_boot_stats();
 }
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// The subset of bionic's property area interface init_raphael.cpp uses, for
+// host builds against the fake area in init_raphael_test.cpp.
+
+#include <stddef.h>
+#include <string.h>
+
+#define PROP_NAME_MAX 32
+#define PROP_VALUE_MAX 92
+
+struct prop_info;
+
+const prop_info* __system_property_find(const char* name);
+int __system_property_update(prop_info* pi, const char* value, unsigned int len);
+int __system_property_add(const char* name, unsigned int namelen, const char* value,
+                          unsigned int valuelen);
+int __system_property_get(const char* name, char* value);
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t copy = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return len;
+}
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Built together with the code under test, so the constexpr tables are
+// visible here.
+#include "../init_raphael.cpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+
+// A fake property area behind the bionic interface.
+struct prop_info {
+    std::string value;
+};
+
+static std::map<std::string, prop_info> props;
+
+const prop_info* __system_property_find(const char* name) {
+    auto it = props.find(name);
+    return it == props.end() ? nullptr : &it->second;
+}
+
+int __system_property_update(prop_info* pi, const char* value, unsigned int len) {
+    if (len >= PROP_VALUE_MAX) return -1;
+    pi->value.assign(value, len);
+    return 0;
+}
+
+int __system_property_add(const char* name, unsigned int namelen, const char* value,
+                          unsigned int valuelen) {
+    if (valuelen >= PROP_VALUE_MAX) return -1;
+    props[std::string(name, namelen)].value.assign(value, valuelen);
+    return 0;
+}
+
+int __system_property_get(const char* name, char* value) {
+    auto it = props.find(name);
+    if (it == props.end()) {
+        value[0] = '\0';
+        return 0;
+    }
+    strlcpy(value, it->second.value.c_str(), PROP_VALUE_MAX);
+    return it->second.value.size();
+}
+
+namespace {
+
+constexpr bool name_is(const prop_name& name, std::string_view expected) {
+    return std::string_view(name.data()) == expected;
+}
+
+static_assert(name_is(make_prop_name("ro.product.", "", "model"), "ro.product.model"));
+static_assert(name_is(make_prop_name("ro.product.", "system_ext.", "device"),
+                      "ro.product.system_ext.device"));
+static_assert(name_is(ro_product_model_props[0], "ro.product.model"));
+static_assert(name_is(ro_product_device_props.back(), "ro.product.vendor.device"));
+
+class InitRaphaelTest : public ::testing::Test {
+  protected:
+    InitRaphaelTest() {
+        props.clear();
+        stats = {};
+        // Only partitions that set a product property get it overridden.
+        props["ro.product.device"].value = "generic";
+        props["ro.product.vendor.device"].value = "generic";
+        props["ro.product.model"].value = "generic";
+        props["ro.product.system.model"].value = "generic";
+    }
+
+    static std::string get(const std::string& name) {
+        auto it = props.find(name);
+        return it == props.end() ? "<unset>" : it->second.value;
+    }
+
+    static void boot(const char* hwc) {
+        if (hwc) props["ro.boot.hwc"].value = hwc;
+        vendor_load_properties();
+    }
+};
+
+}  // anonymous namespace
+
+TEST(InitRaphaelVariantTest, UnknownRegionFallsBackToGlobal) {
+    EXPECT_EQ(find_variant("GLOBAL").region, "GLOBAL");
+    EXPECT_EQ(find_variant("CN").region, "CN");
+    EXPECT_EQ(find_variant("INDIA").region, "INDIA");
+    EXPECT_EQ(&find_variant("XX"), &variants[0]);
+    EXPECT_EQ(&find_variant(""), &variants[0]);
+    EXPECT_EQ(variants[0].region, "GLOBAL");
+}
+
+TEST(InitRaphaelVariantTest, DescriptionsFitPropertyValues) {
+    for (const auto& v : variants) {
+        EXPECT_LT(strlen(v.description), PROP_VALUE_MAX) << v.region;
+    }
+}
+
+TEST_F(InitRaphaelTest, Global) {
+    boot("GLOBAL");
+    EXPECT_EQ(get("ro.product.device"), "raphael");
+    EXPECT_EQ(get("ro.product.vendor.device"), "raphael");
+    EXPECT_EQ(get("ro.product.model"), "Mi 9T Pro");
+    EXPECT_EQ(get("ro.product.system.model"), "Mi 9T Pro");
+    EXPECT_EQ(get("ro.product.mod_device"), "raphael_global");
+    EXPECT_EQ(get("ro.boot.hardware.sku"), "raphael");
+    EXPECT_EQ(get("ro.build.description"), variants[0].description);
+}
+
+TEST_F(InitRaphaelTest, China) {
+    boot("CN");
+    EXPECT_EQ(get("ro.product.device"), "raphael");
+    EXPECT_EQ(get("ro.product.model"), "Redmi K20 Pro");
+    EXPECT_EQ(get("ro.product.mod_device"), "<unset>");
+}
+
+TEST_F(InitRaphaelTest, India) {
+    boot("INDIA");
+    EXPECT_EQ(get("ro.product.device"), "raphaelin");
+    EXPECT_EQ(get("ro.product.vendor.device"), "raphaelin");
+    EXPECT_EQ(get("ro.product.model"), "Redmi K20 Pro");
+    EXPECT_EQ(get("ro.product.mod_device"), "raphaelin_in_global");
+    EXPECT_EQ(get("ro.boot.product.hardware.sku"), "raphaelin");
+}
+
+TEST_F(InitRaphaelTest, MissingOrUnknownRegionIsGlobal) {
+    for (const char* hwc : {static_cast<const char*>(nullptr), "XX"}) {
+        props.erase("ro.boot.hwc");
+        boot(hwc);
+        EXPECT_EQ(get("ro.product.model"), "Mi 9T Pro") << (hwc ? hwc : "unset");
+        EXPECT_EQ(get("ro.product.mod_device"), "raphael_global");
+    }
+}
+
+TEST_F(InitRaphaelTest, ProductPropsAreNeverAdded) {
+    boot("GLOBAL");
+    for (auto names : {ro_product_device_props, ro_product_model_props}) {
+        for (const auto& name : names) {
+            std::string value = get(name.data());
+            EXPECT_TRUE(value == "<unset>" || value == "raphael" || value == "Mi 9T Pro")
+                    << name.data() << "=" << value;
+        }
+    }
+    EXPECT_EQ(get("ro.product.odm.device"), "<unset>");
+    EXPECT_EQ(get("ro.product.bootimage.model"), "<unset>");
+}
+
+TEST_F(InitRaphaelTest, HardwareRevision) {
+    boot(nullptr);
+    EXPECT_EQ(get("ro.boot.hardware.revision"), "UNKNOWN");
+
+    props["ro.boot.hwversion"].value = "5.19.1";
+    boot(nullptr);
+    EXPECT_EQ(get("ro.boot.hardware.revision"), "5.19.1");
+}
+
+TEST(InitRaphaelMemoryClassTest, SmallestTierKeepsDefaults) {
+    const memory_class& mc = memory_classes[0];
+    // Stock heap of the device, ART's JIT cache and lmkd's defaults.
+    EXPECT_STREQ(mc.heapgrowthlimit, "256m");
+    EXPECT_STREQ(mc.heapsize, "512m");
+    EXPECT_STREQ(mc.jitinitialsize, "64k");
+    EXPECT_STREQ(mc.jitmaxsize, "64m");
+    EXPECT_STREQ(mc.lmk_thrashing_limit, "100");
+    EXPECT_STREQ(mc.lmk_swap_free_low_percentage, "10");
+    EXPECT_STREQ(mc.lmk_psi_partial_stall_ms, "70");
+}
+
+TEST(InitRaphaelMemoryClassTest, LargerTiersAreMorePatient) {
+    for (size_t i = 1; i < std::size(memory_classes); i++) {
+        const memory_class& smaller = memory_classes[i - 1];
+        const memory_class& mc = memory_classes[i];
+        EXPECT_GT(mc.max_ram_mb, smaller.max_ram_mb);
+        EXPECT_GE(atoi(mc.lmk_thrashing_limit), atoi(smaller.lmk_thrashing_limit));
+        EXPECT_LE(atoi(mc.lmk_swap_free_low_percentage),
+                  atoi(smaller.lmk_swap_free_low_percentage));
+        EXPECT_GE(atoi(mc.lmk_psi_partial_stall_ms), atoi(smaller.lmk_psi_partial_stall_ms));
+        EXPECT_GE(atoi(mc.jitmaxsize), atoi(smaller.jitmaxsize));
+    }
+}
+
+TEST_F(InitRaphaelTest, BootStatsPublished) {
+    props["ro.boot.hwc"].value = "GLOBAL";
+    std::set<std::string> before;
+    for (const auto& [name, pi] : props) before.insert(name);
+    vendor_load_properties();
+
+    uint64_t added = 0;
+    std::map<std::string, uint64_t> exported;
+    for (const auto& [name, pi] : props) {
+        if (name.rfind("ro.vendor.init.", 0) == 0) {
+            char* end;
+            exported[name] = strtoull(pi.value.c_str(), &end, 10);
+            EXPECT_EQ(*end, '\0') << name << "=" << pi.value;
+            RecordProperty(name, pi.value);
+        } else if (!before.count(name)) {
+            added++;
+        }
+    }
+    ASSERT_EQ(exported.size(), 9u);
+
+    // The snapshot is taken before publishing, so the stats don't count
+    // their own properties.
+    EXPECT_EQ(exported["ro.vendor.init.lookups"], 2u);
+    EXPECT_EQ(exported["ro.vendor.init.props_added"], added);
+    // Everything preset but ro.boot.hwc is overridden.
+    EXPECT_EQ(exported["ro.vendor.init.props_updated"], before.size() - 1);
+    EXPECT_EQ(stats.added, added + exported.size());
+
+    EXPECT_GT(exported["ro.vendor.init.total_ns"], 0u);
+    EXPECT_GE(exported["ro.vendor.init.total_ns"], exported["ro.vendor.init.memory_class_ns"] +
+                                                          exported["ro.vendor.init.dex2oat_ns"] +
+                                                          exported["ro.vendor.init.lookup_ns"]);
+    EXPECT_GE(exported["ro.vendor.init.memory_class_ns"], exported["ro.vendor.init.sysinfo_ns"]);
+    EXPECT_GE(exported["ro.vendor.init.total_ns"], exported["ro.vendor.init.override_ns"]);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LedPattern.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// LUT entries available to a single LED channel.
+constexpr uint32_t kMaxLutEntries = 16;
+
+// The entry at the low index is kept dark for the off period, the on period
+// gets the rest.
+constexpr uint32_t kMaxOnEntries = kMaxLutEntries - 1;
+
+// Ramp step limits of the LPG, in ms.
+constexpr uint32_t kMinStepMs = 1;
+constexpr uint32_t kMaxStepMs = 511;
+
+// Largest pause the controller can hold at the low index, in steps.
+constexpr uint32_t kMaxPauseCount = 255;
+
+// Index of the first LUT entry used by the pattern.
+constexpr uint32_t kLutStartIndex = 0;
+
+// Perceived brightness is roughly the square of the duty cycle.
+constexpr double kRampGamma = 2.0;
+
+uint32_t DivRoundUp(uint32_t a, uint32_t b) {
+    return (a + b - 1) / b;
+}
+
+uint32_t DivRound(uint32_t a, uint32_t b) {
+    return (a + b / 2) / b;
+}
+
+}  // anonymous namespace
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+std::string LedPattern::lutString() const {
+    std::string out;
+    for (auto duty : duty_pcts) {
+        if (!out.empty()) out += " ";
+        out += std::to_string(duty);
+    }
+    return out;
+}
+
+LedPattern CompileLedPattern(uint32_t on_ms, uint32_t off_ms, uint32_t brightness,
+                             uint32_t max_brightness) {
+    LedPattern pattern{};
+    pattern.lo_idx = kLutStartIndex;
+
+    on_ms = std::max(on_ms, kMinStepMs);
+
+    // Use as many entries as possible for a smooth ramp, but the step has to be
+    // long enough for the off period to fit into the dark entry plus the pause
+    // counter.
+    uint32_t steps = std::clamp(on_ms / kMinStepMs, 1u, kMaxOnEntries);
+    uint32_t step_ms = std::max(DivRound(on_ms, steps), kMinStepMs);
+    uint32_t min_step_ms = DivRoundUp(off_ms, kMaxPauseCount + 1);
+    if (step_ms < min_step_ms) {
+        step_ms = min_step_ms;
+        steps = std::clamp(DivRound(on_ms, step_ms), 1u, kMaxOnEntries);
+    }
+    if (step_ms > kMaxStepMs) {
+        step_ms = kMaxStepMs;
+        steps = std::clamp(DivRound(on_ms, step_ms), 1u, kMaxOnEntries);
+    }
+
+    pattern.step_ms = step_ms;
+    uint32_t off_steps = std::max(DivRound(off_ms, step_ms), 1u);
+    pattern.pause_lo_count = std::min(off_steps - 1, kMaxPauseCount);
+
+    uint32_t peak = max_brightness ? std::min(brightness, max_brightness) * 100 / max_brightness
+                                   : 0;
+
+    pattern.duty_pcts.push_back(0);
+
+    // A quarter of the on period each for ramping up and down, the rest is held
+    // at peak. Short patterns simply become a square pulse.
+    uint32_t ramp = steps / 4;
+    for (uint32_t i = 0; i < steps; i++) {
+        uint32_t pos = std::min(i + 1, steps - i);
+        if (pos > ramp) {
+            pattern.duty_pcts.push_back(peak);
+        } else {
+            double level = std::pow(static_cast<double>(pos) / (ramp + 1), kRampGamma);
+            pattern.duty_pcts.push_back(static_cast<uint32_t>(std::lround(level * peak)));
+        }
+    }
+
+    return pattern;
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+// A flash pattern in the form the LPG lookup-table ramp understands. Once
+// programmed the controller plays it back on its own, without any help from
+// the AP.
+struct LedPattern {
+    uint32_t step_ms;
+    uint32_t pause_lo_count;
+    uint32_t lo_idx;
+    // The first entry is the 0% duty cycle held at lo_idx, the rest is the on
+    // period.
+    std::vector<uint32_t> duty_pcts;
+
+    // Timing the hardware will actually produce for this pattern. The off entry
+    // plays for one step before the pause starts.
+    uint32_t onMs() const { return step_ms * (duty_pcts.size() - 1); }
+    uint32_t offMs() const { return step_ms * (pause_lo_count + 1); }
+
+    // Space separated duty cycles, as expected by the lut_pattern attribute.
+    std::string lutString() const;
+};
+
+// Converts the requested on/off durations and brightness into the closest
+// pattern the LUT ramp can play. The on period is a ramp up, a hold at peak
+// brightness and a ramp down; the off period is a pause at the low index.
+LedPattern CompileLedPattern(uint32_t on_ms, uint32_t off_ms, uint32_t brightness,
+                             uint32_t max_brightness);
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
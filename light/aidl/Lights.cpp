@@ -18,8 +18,14 @@
 #define LOG_TAG "android.hardware.lights-service_xiaomi.raphael"
 
 #include "Lights.h"
+#include "LedPattern.h"
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <chrono>
+#include <cinttypes>
 
 namespace {
 
@@ -34,17 +40,22 @@ namespace {
 /* clang-format on */
 
 using ::android::base::ReadFileToString;
+using ::android::base::StringAppendF;
+using ::android::base::Trim;
+using ::android::base::WriteStringToFd;
 using ::android::base::WriteStringToFile;
 
 // Default max brightness
 constexpr auto kDefaultMaxLedBrightness = 255;
 
-// Each step will stay on for 70ms by default.
-constexpr auto kRampStepDurationDefault = 70;
+// Power supply class trigger driving the LED while charging or full.
+constexpr auto kBatteryTrigger = "battery-charging-or-full";
+constexpr auto kNoTrigger = "none";
+constexpr auto kBatteryStatusPath = "/sys/class/power_supply/battery/status";
 
 // Write value to path and close file.
-bool WriteToFile(const std::string& path, uint32_t content) {
-    return WriteStringToFile(std::to_string(content), path);
+bool WriteToFile(const std::string& path, const std::string& content) {
+    return WriteStringToFile(content, path);
 }
 
 uint32_t RgbaToBrightness(uint32_t color) {
@@ -74,6 +85,21 @@ inline bool IsLit(uint32_t color) {
     return color & 0x00ffffff;
 }
 
+// Whether the battery trigger would currently light the LED.
+bool IsChargingOrFull() {
+    std::string status;
+    if (!ReadFileToString(kBatteryStatusPath, &status)) {
+        PLOG(ERROR) << "Failed to read " << kBatteryStatusPath;
+        return false;
+    }
+    status = Trim(status);
+    return status == "Charging" || status == "Full";
+}
+
+inline std::string MakeLedPath(const std::string& led, const std::string& op) {
+    return "/sys/class/leds/" + led + "/" + op;
+}
+
 }  // anonymous namespace
 
 namespace aidl {
@@ -106,6 +132,17 @@ Lights::Lights() {
         max_led_brightness_ = kDefaultMaxLedBrightness;
         LOG(ERROR) << "Failed to read max LED brightness, fallback to " << kDefaultMaxLedBrightness;
     }
+
+    apply_thread_ = std::thread(&Lights::applyLoop, this);
+}
+
+Lights::~Lights() {
+    {
+        std::lock_guard<std::mutex> lock(apply_lock_);
+        apply_exit_ = true;
+    }
+    apply_cv_.notify_one();
+    apply_thread_.join();
 }
 
 ndk::ScopedAStatus Lights::setLightState(int id, const HwLightState& state) {
@@ -121,6 +158,46 @@ ndk::ScopedAStatus Lights::setLightState(int id, const HwLightState& state) {
     return ndk::ScopedAStatus::ok();
 }
 
+binder_status_t Lights::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    std::string out;
+
+    {
+        std::lock_guard<std::mutex> lock(apply_lock_);
+        StringAppendF(&out, "Notification states:\n");
+        for (const auto& [id, state] : notif_states_) {
+            StringAppendF(&out, "  %d: %s\n", id, state.toString().c_str());
+        }
+        StringAppendF(&out, "  pending: %d, skipped: %" PRIu64 "\n", apply_pending_,
+                      skipped_states_.load());
+    }
+
+    std::lock_guard<std::mutex> lock(stats_lock_);
+    StringAppendF(&out, "Effective state: id=%d %s\n", applied_id_,
+                  applied_state_.toString().c_str());
+
+    StringAppendF(&out, "LED attribute writes (reduction %.3f):\n", ledWriteReductionRatio());
+    for (const auto& [path, stats] : attr_stats_) {
+        StringAppendF(&out, "  %s: %" PRIu64 " writes, %" PRIu64 " failures\n", path.c_str(),
+                      stats.writes, stats.failures);
+    }
+
+    StringAppendF(&out, "LED apply latency:\n");
+    for (size_t i = 0; i < apply_latency_hist_.size(); i++) {
+        if (i < kLatencyBucketsUs.size()) {
+            StringAppendF(&out, "  < %" PRIu64 "us: ", kLatencyBucketsUs[i]);
+        } else {
+            StringAppendF(&out, "  >= %" PRIu64 "us: ", kLatencyBucketsUs.back());
+        }
+        StringAppendF(&out, "%" PRIu64 "\n", apply_latency_hist_[i]);
+    }
+
+    StringAppendF(&out, "applyNotificationState: %" PRIu64 " calls, %" PRIu64 "us total, %" PRIu64
+                        "us max\n",
+                  apply_count_, apply_total_ns_ / 1000, apply_max_ns_ / 1000);
+
+    return WriteStringToFd(out, fd) ? STATUS_OK : STATUS_UNKNOWN_ERROR;
+}
+
 ndk::ScopedAStatus Lights::getLights(std::vector<HwLight>* lights) {
     for (auto i = mAvailableLights.begin(); i != mAvailableLights.end(); i++) {
         lights->push_back(*i);
@@ -129,46 +206,184 @@ ndk::ScopedAStatus Lights::getLights(std::vector<HwLight>* lights) {
 }
 
 void Lights::setLightNotification(int id, const HwLightState& state) {
-    bool found = false;
-    for (auto&& [cur_id, cur_state] : notif_states_) {
-        if (cur_id == id) {
-            cur_state = state;
+    {
+        std::lock_guard<std::mutex> lock(apply_lock_);
+        for (auto&& [cur_id, cur_state] : notif_states_) {
+            if (cur_id == id) {
+                cur_state = state;
+            }
+        }
+
+        // Only the latest state is ever applied; count the one it supersedes.
+        if (apply_pending_) {
+            skipped_states_++;
+        }
+        apply_pending_ = true;
+    }
+    apply_cv_.notify_one();
+}
+
+void Lights::applyLoop() {
+    std::unique_lock<std::mutex> lock(apply_lock_);
+    while (true) {
+        apply_cv_.wait(lock, [this] { return apply_pending_ || apply_exit_; });
+        if (apply_exit_) {
+            return;
+        }
+        apply_pending_ = false;
+
+        int effective_id = (int)LightType::BATTERY;
+        HwLightState effective;
+        for (auto&& [cur_id, cur_state] : notif_states_) {
+            // Fallback to battery light
+            if (cur_id == (int)LightType::BATTERY || IsLit(cur_state.color)) {
+                LOG(DEBUG) << __func__ << ": id=" << cur_id;
+                effective_id = cur_id;
+                effective = cur_state;
+                break;
+            }
         }
 
-        // Fallback to battery light
-        if (!found && (cur_id == (int)LightType::BATTERY || IsLit(cur_state.color))) {
-            found = true;
-            LOG(DEBUG) << __func__ << ": id=" << id;
-            applyNotificationState(cur_state);
+        // Don't hold the lock across the sysfs writes so callers never block on them.
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        // The trigger lights the LED at full brightness while charging or full and
+        // turns it off otherwise, so it can only stand in for a request that
+        // asks for exactly that.
+        if (effective_id == (int)LightType::BATTERY && effective.flashMode == FlashMode::NONE &&
+            RgbaToBrightness(effective.color, max_led_brightness_) == max_led_brightness_ &&
+            IsChargingOrFull()) {
+            applyBatteryTrigger();
+        } else {
+            applyNotificationState(effective);
+        }
+        uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count();
+        uint64_t elapsed_us = elapsed_ns / 1000;
+        size_t bucket = 0;
+        while (bucket < kLatencyBucketsUs.size() && elapsed_us >= kLatencyBucketsUs[bucket]) {
+            bucket++;
+        }
+        {
+            std::lock_guard<std::mutex> stats_lock(stats_lock_);
+            apply_latency_hist_[bucket]++;
+            applied_id_ = effective_id;
+            applied_state_ = effective;
+            apply_count_++;
+            apply_total_ns_ += elapsed_ns;
+            apply_max_ns_ = std::max(apply_max_ns_, elapsed_ns);
         }
+        lock.lock();
     }
 }
 
+uint64_t Lights::skippedStates() const {
+    return skipped_states_;
+}
+
+void Lights::applyBatteryTrigger() {
+    // Let the kernel follow the charging state from here on, so charge level
+    // updates don't need any further writes from us.
+    writeLedAttr("green", "breath", "0");
+    writeLedAttr("green", "trigger", kBatteryTrigger);
+}
+
 void Lights::applyNotificationState(const HwLightState& state) {
     std::map<std::string, int> colorValues;
     colorValues["green"] = RgbaToBrightness(state.color, max_led_brightness_);
 
-    auto makeLedPath = [](const std::string& led, const std::string& op) -> std::string {
-        return "/sys/class/leds/" + led + "/" + op;
-    };
+    // Take the LED back from the battery trigger, it is restored once the
+    // notification clears.
     for (const auto& entry : colorValues) {
-        // Turn off the leds (initially)
-        WriteToFile(makeLedPath(entry.first, "breath"), 0);
-        if (state.flashMode == FlashMode::TIMED && state.flashOnMs > 0 && state.flashOffMs > 0) {
-            WriteToFile(makeLedPath(entry.first, "step_ms"),
-                        static_cast<uint32_t>(kRampStepDurationDefault)),
-                    WriteToFile(makeLedPath(entry.first, "pause_lo_count"), 30),
-                    WriteToFile(makeLedPath(entry.first, "lo_idx"), 0);
-            WriteToFile(makeLedPath(entry.first, "lux_pattern"), 0);
-            WriteToFile(makeLedPath(entry.first, "delay_on"),
-                        static_cast<uint32_t>(state.flashOnMs));
-            WriteToFile(makeLedPath(entry.first, "delay_off"),
-                        static_cast<uint32_t>(state.flashOffMs));
-            WriteToFile(makeLedPath(entry.first, "breath"), 1);
+        writeLedAttr(entry.first, "trigger", kNoTrigger);
+    }
+
+    bool flashing = state.flashMode != FlashMode::NONE && state.flashOnMs > 0 &&
+                    state.flashOffMs > 0;
+
+    for (const auto& entry : colorValues) {
+        if (flashing && entry.second > 0) {
+            LedPattern lut = CompileLedPattern(state.flashOnMs, state.flashOffMs, entry.second,
+                                               max_led_brightness_);
+            LOG(DEBUG) << __func__ << ": " << state.flashOnMs << "/" << state.flashOffMs
+                       << "ms -> step " << lut.step_ms << "ms x " << lut.duty_pcts.size()
+                       << ", pause " << lut.pause_lo_count << " [" << lut.lutString() << "]";
+
+            const std::vector<std::pair<std::string, std::string>> pattern = {
+                    {"step_ms", std::to_string(lut.step_ms)},
+                    {"pause_lo_count", std::to_string(lut.pause_lo_count)},
+                    {"lo_idx", std::to_string(lut.lo_idx)},
+                    {"lut_pattern", lut.lutString()},
+                    {"delay_on", std::to_string(lut.onMs())},
+                    {"delay_off", std::to_string(lut.offMs())},
+            };
+
+            // The pattern is only latched when breathing is (re)started, so any
+            // change requires stopping the ramp first and restarting it after.
+            bool restart = !isLedAttrCached(entry.first, "breath", "1");
+            for (const auto& [attr, value] : pattern) {
+                restart |= !isLedAttrCached(entry.first, attr, value);
+            }
+
+            writeLedAttr(entry.first, "breath", "0", restart);
+            for (const auto& [attr, value] : pattern) {
+                writeLedAttr(entry.first, attr, value);
+            }
+            writeLedAttr(entry.first, "breath", "1", restart);
         } else {
-            WriteToFile(makeLedPath(entry.first, "brightness"), entry.second);
+            // Turn off the ramp (if running) before setting a solid brightness
+            writeLedAttr(entry.first, "breath", "0");
+            writeLedAttr(entry.first, "brightness", std::to_string(entry.second));
         }
     }
+
+    LOG(DEBUG) << __func__ << ": write reduction " << ledWriteReductionRatio();
+}
+
+bool Lights::isLedAttrCached(const std::string& led, const std::string& attr,
+                             const std::string& value) const {
+    auto it = led_attr_cache_.find(MakeLedPath(led, attr));
+    return it != led_attr_cache_.end() && it->second == value;
+}
+
+bool Lights::writeLedAttr(const std::string& led, const std::string& attr,
+                          const std::string& value, bool force) {
+    led_writes_requested_++;
+
+    const std::string path = MakeLedPath(led, attr);
+    if (!force && isLedAttrCached(led, attr, value)) {
+        led_writes_skipped_++;
+        return true;
+    }
+
+    // Starting or stopping the ramp or changing the trigger changes the driver's
+    // brightness behind our back.
+    if (attr == "breath" || attr == "trigger") {
+        led_attr_cache_.erase(MakeLedPath(led, "brightness"));
+    }
+
+    bool ok = WriteToFile(path, value);
+    {
+        std::lock_guard<std::mutex> lock(stats_lock_);
+        auto& stats = attr_stats_[path];
+        stats.writes++;
+        if (!ok) stats.failures++;
+    }
+
+    if (!ok) {
+        LOG(ERROR) << "Failed to write " << value << " to " << path;
+        led_attr_cache_.erase(path);
+        return false;
+    }
+
+    led_attr_cache_[path] = value;
+    return true;
+}
+
+float Lights::ledWriteReductionRatio() const {
+    if (led_writes_requested_ == 0) return 0.0f;
+    return static_cast<float>(led_writes_skipped_) / led_writes_requested_;
 }
 
 }  // namespace light
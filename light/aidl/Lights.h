@@ -20,8 +20,12 @@
 #include <aidl/android/hardware/light/BnLights.h>
 #include <hardware/hardware.h>
 #include <hardware/lights.h>
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace aidl {
 namespace android {
@@ -31,15 +35,35 @@ namespace light {
 class Lights : public BnLights {
   public:
     Lights();
+    ~Lights();
     ndk::ScopedAStatus setLightState(int id, const HwLightState& state) override;
     ndk::ScopedAStatus getLights(std::vector<HwLight>* types) override;
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
+    // Fraction of requested LED attribute writes that were skipped because the
+    // cached value already matched.
+    float ledWriteReductionRatio() const;
+
+    // Number of notification states superseded before the worker applied them.
+    uint64_t skippedStates() const;
 
   private:
     void setLightNotification(int id, const HwLightState& state);
     void applyNotificationState(const HwLightState& state);
+    void applyBatteryTrigger();
+    void applyLoop();
+    bool writeLedAttr(const std::string& led, const std::string& attr, const std::string& value,
+                      bool force = false);
+    bool isLedAttrCached(const std::string& led, const std::string& attr,
+                         const std::string& value) const;
 
     uint32_t max_led_brightness_;
 
+    // Last value successfully written to each LED attribute, keyed by sysfs path.
+    std::map<std::string, std::string> led_attr_cache_;
+    std::atomic<uint64_t> led_writes_requested_ = 0;
+    std::atomic<uint64_t> led_writes_skipped_ = 0;
+
     std::map<int, std::function<void(int id, const HwLightState&)>> mLights;
     std::vector<HwLight> mAvailableLights;
 
@@ -48,6 +72,30 @@ class Lights : public BnLights {
             {(int)LightType::NOTIFICATIONS, {}},
             {(int)LightType::BATTERY, {}},
     }};
+
+    // LED writes happen on apply_thread_; notif_states_ is guarded by apply_lock_.
+    std::thread apply_thread_;
+    std::mutex apply_lock_;
+    std::condition_variable apply_cv_;
+    bool apply_pending_ = false;
+    bool apply_exit_ = false;
+    std::atomic<uint64_t> skipped_states_ = 0;
+
+    // Instrumentation reported through dump(), guarded by stats_lock_.
+    struct AttrStats {
+        uint64_t writes = 0;
+        uint64_t failures = 0;
+    };
+    static constexpr std::array<uint64_t, 7> kLatencyBucketsUs = {10,   50,   100,  500,
+                                                                   1000, 5000, 10000};
+    mutable std::mutex stats_lock_;
+    std::map<std::string, AttrStats> attr_stats_;
+    std::array<uint64_t, kLatencyBucketsUs.size() + 1> apply_latency_hist_ = {};
+    int applied_id_ = -1;
+    HwLightState applied_state_;
+    uint64_t apply_count_ = 0;
+    uint64_t apply_total_ns_ = 0;
+    uint64_t apply_max_ns_ = 0;
 };
 
 }  // namespace light
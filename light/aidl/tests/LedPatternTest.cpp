@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LedPattern.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+using aidl::android::hardware::light::CompileLedPattern;
+using aidl::android::hardware::light::LedPattern;
+
+namespace {
+
+constexpr uint32_t kMaxBrightness = 255;
+
+// Checks the invariants every pattern has to satisfy for the LPG to play it.
+void ExpectPlayable(const LedPattern& pattern) {
+    ASSERT_GE(pattern.duty_pcts.size(), 2u);
+    EXPECT_LE(pattern.duty_pcts.size(), 16u);
+    EXPECT_GE(pattern.step_ms, 1u);
+    EXPECT_LE(pattern.step_ms, 511u);
+    EXPECT_LE(pattern.pause_lo_count, 255u);
+
+    // The pause is held at lo_idx, which has to be dark.
+    EXPECT_EQ(pattern.lo_idx, 0u);
+    EXPECT_EQ(pattern.duty_pcts[pattern.lo_idx], 0u);
+    for (size_t i = 1; i < pattern.duty_pcts.size(); i++) {
+        EXPECT_GT(pattern.duty_pcts[i], 0u) << "entry " << i;
+        EXPECT_LE(pattern.duty_pcts[i], 100u) << "entry " << i;
+    }
+}
+
+}  // anonymous namespace
+
+TEST(LedPatternTest, OffPeriodIsDark) {
+    LedPattern pattern = CompileLedPattern(500, 2000, kMaxBrightness, kMaxBrightness);
+    ExpectPlayable(pattern);
+    EXPECT_EQ(pattern.duty_pcts.size(), 16u);
+    EXPECT_EQ(*std::max_element(pattern.duty_pcts.begin(), pattern.duty_pcts.end()), 100u);
+    EXPECT_NEAR(pattern.onMs(), 500, pattern.step_ms);
+    EXPECT_NEAR(pattern.offMs(), 2000, pattern.step_ms);
+}
+
+TEST(LedPatternTest, LongOffPeriodFitsPauseCounter) {
+    LedPattern pattern = CompileLedPattern(100, 10000, kMaxBrightness, kMaxBrightness);
+    ExpectPlayable(pattern);
+    EXPECT_EQ(pattern.step_ms, 40u);
+    EXPECT_EQ(pattern.lutString(), "0 100 100 100");
+    EXPECT_EQ(pattern.onMs(), 120u);
+    EXPECT_EQ(pattern.offMs(), 10000u);
+}
+
+TEST(LedPatternTest, ShortOffPeriodStillHasDarkStep) {
+    LedPattern pattern = CompileLedPattern(1000, 1, kMaxBrightness, kMaxBrightness);
+    ExpectPlayable(pattern);
+    EXPECT_EQ(pattern.pause_lo_count, 0u);
+    EXPECT_EQ(pattern.offMs(), pattern.step_ms);
+}
+
+TEST(LedPatternTest, PeakFollowsBrightness) {
+    LedPattern pattern = CompileLedPattern(1000, 1000, kMaxBrightness / 2, kMaxBrightness);
+    ExpectPlayable(pattern);
+    EXPECT_EQ(*std::max_element(pattern.duty_pcts.begin(), pattern.duty_pcts.end()), 49u);
+}
+
+TEST(LedPatternTest, TimingWithinOneStep) {
+    for (uint32_t on_ms : {1u, 10u, 100u, 500u, 1000u, 3000u}) {
+        for (uint32_t off_ms : {1u, 100u, 1000u, 5000u, 10000u}) {
+            SCOPED_TRACE(std::to_string(on_ms) + "/" + std::to_string(off_ms));
+            LedPattern pattern = CompileLedPattern(on_ms, off_ms, kMaxBrightness, kMaxBrightness);
+            ExpectPlayable(pattern);
+            EXPECT_LE(std::abs(static_cast<int>(pattern.onMs()) - static_cast<int>(on_ms)),
+                      static_cast<int>(pattern.step_ms));
+            EXPECT_LE(std::abs(static_cast<int>(pattern.offMs()) - static_cast<int>(off_ms)),
+                      static_cast<int>(pattern.step_ms));
+        }
+    }
+}
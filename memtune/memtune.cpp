@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "memtune"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstring>
+#include <string>
+
+using ::android::base::StringPrintf;
+using ::android::base::unique_fd;
+
+namespace {
+
+constexpr const char* kPsiPath = "/proc/pressure/memory";
+constexpr const char* kSwappinessPath = "/proc/sys/vm/swappiness";
+constexpr const char* kWatermarkScalePath = "/proc/sys/vm/watermark_scale_factor";
+constexpr const char* kBgSwappinessPath = "/sys/fs/cgroup/memory/bg/memory.swappiness";
+constexpr const char* kBgSoftLimitPath = "/sys/fs/cgroup/memory/bg/memory.soft_limit_in_bytes";
+constexpr const char* kMemInfoPath = "/proc/meminfo";
+
+constexpr const char* kLogPath = "/data/vendor/memtune/decisions.log";
+constexpr const char* kOldLogPath = "/data/vendor/memtune/decisions.log.old";
+constexpr off_t kLogMaxSize = 256 * 1024;
+
+// PSI triggers, "<some|full> <stall us> <window us>".
+constexpr const char* kMediumTrigger = "some 100000 1000000";
+constexpr const char* kHighTrigger = "full 50000 1000000";
+
+// Without a trigger for this long, pressure drops by one level.
+constexpr int kRelaxTimeoutMs = 30000;
+
+enum Level { LOW, MEDIUM, HIGH, LEVEL_COUNT };
+
+constexpr std::array<const char*, LEVEL_COUNT + 1> kLevelNames = {"low", "medium", "high", "unset"};
+
+struct Tuning {
+    int swappiness;
+    int watermark_scale_factor;
+    int bg_swappiness;
+    // Background memcg soft limit in percent of MemTotal, 0 for unlimited.
+    int bg_soft_limit_pct;
+};
+
+// MEDIUM matches the values init used to write once at boot. LOW lets an
+// idle device reclaim gently, HIGH wakes kswapd earlier and pushes reclaim
+// towards the background group so the foreground doesn't thrash zram.
+constexpr std::array<Tuning, LEVEL_COUNT> kTunings = {{
+        {60, 1, 100, 0},
+        {100, 1, 140, 0},
+        {80, 30, 160, 12},
+}};
+
+// Bounds every value is clamped to before it is written.
+constexpr int kSwappinessMin = 10;
+constexpr int kSwappinessMax = 100;
+constexpr int kBgSwappinessMax = 200;
+constexpr int kWatermarkScaleMin = 1;
+constexpr int kWatermarkScaleMax = 100;
+constexpr int kSoftLimitPctMin = 5;
+
+uint64_t nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+uint64_t memTotalBytes() {
+    std::string meminfo;
+    if (!::android::base::ReadFileToString(kMemInfoPath, &meminfo)) return 0;
+    for (const auto& line : ::android::base::Split(meminfo, "\n")) {
+        uint64_t kb;
+        if (sscanf(line.c_str(), "MemTotal: %" SCNu64 " kB", &kb) == 1) return kb * 1024;
+    }
+    return 0;
+}
+
+unique_fd openTrigger(const char* trigger) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(kPsiPath, O_RDWR | O_NONBLOCK | O_CLOEXEC)));
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to open " << kPsiPath;
+        return fd;
+    }
+    if (TEMP_FAILURE_RETRY(write(fd, trigger, strlen(trigger) + 1)) < 0) {
+        PLOG(ERROR) << "Failed to register PSI trigger \"" << trigger << "\"";
+        fd.reset();
+    }
+    return fd;
+}
+
+class MemTuner {
+  public:
+    MemTuner() : mem_total_(memTotalBytes()) {}
+
+    void setLevel(Level level, const std::string& reason) {
+        if (level == level_) return;
+
+        const Tuning& t = kTunings[level];
+        write(kSwappinessPath, std::clamp(t.swappiness, kSwappinessMin, kSwappinessMax));
+        write(kWatermarkScalePath,
+              std::clamp(t.watermark_scale_factor, kWatermarkScaleMin, kWatermarkScaleMax));
+        write(kBgSwappinessPath, std::clamp(t.bg_swappiness, kSwappinessMin, kBgSwappinessMax));
+
+        std::string soft_limit = "-1";
+        if (t.bg_soft_limit_pct > 0 && mem_total_ > 0) {
+            int pct = std::clamp(t.bg_soft_limit_pct, kSoftLimitPctMin, 100);
+            soft_limit = std::to_string(mem_total_ / 100 * pct);
+        }
+        writeString(kBgSoftLimitPath, soft_limit);
+
+        record(StringPrintf("%s -> %s (%s) swappiness=%d wsf=%d bg_swappiness=%d "
+                            "bg_soft_limit=%s",
+                            kLevelNames[level_], kLevelNames[level], reason.c_str(),
+                            t.swappiness, t.watermark_scale_factor, t.bg_swappiness,
+                            soft_limit.c_str()));
+        level_ = level;
+    }
+
+    Level level() const { return level_; }
+
+  private:
+    static void write(const char* path, int value) { writeString(path, std::to_string(value)); }
+
+    static void writeString(const char* path, const std::string& value) {
+        if (!::android::base::WriteStringToFile(value, path)) {
+            PLOG(ERROR) << "Failed to write " << value << " to " << path;
+        }
+    }
+
+    // Logs a decision to logcat and to a size capped file, together with the
+    // pressure figures that led to it.
+    static void record(const std::string& decision) {
+        std::string psi;
+        ::android::base::ReadFileToString(kPsiPath, &psi);
+        psi = ::android::base::Trim(psi);
+        std::replace(psi.begin(), psi.end(), '\n', ' ');
+
+        LOG(INFO) << decision << " [" << psi << "]";
+
+        struct stat st;
+        if (stat(kLogPath, &st) == 0 && st.st_size > kLogMaxSize) {
+            rename(kLogPath, kOldLogPath);
+        }
+        unique_fd fd(TEMP_FAILURE_RETRY(
+                open(kLogPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0660)));
+        if (fd < 0) return;
+        ::android::base::WriteStringToFd(
+                StringPrintf("%" PRIu64 " %s [%s]\n", nowMs(), decision.c_str(), psi.c_str()),
+                fd);
+    }
+
+    const uint64_t mem_total_;
+    // Nothing is written until the first decision.
+    Level level_ = LEVEL_COUNT;
+};
+
+}  // anonymous namespace
+
+int main() {
+    MemTuner tuner;
+
+    // Start from the former static configuration.
+    tuner.setLevel(MEDIUM, "boot");
+
+    std::array<unique_fd, 2> fds = {openTrigger(kMediumTrigger), openTrigger(kHighTrigger)};
+    if (fds[0] < 0 || fds[1] < 0) {
+        LOG(ERROR) << "PSI unavailable, keeping static memory parameters";
+        return 0;
+    }
+
+    struct pollfd pfds[2] = {{fds[0], POLLPRI, 0}, {fds[1], POLLPRI, 0}};
+    uint64_t last_event = nowMs();
+    while (true) {
+        // Only wake up on a timer while there is a level to relax from.
+        int timeout = -1;
+        if (tuner.level() > LOW) {
+            uint64_t elapsed = nowMs() - last_event;
+            timeout = elapsed >= kRelaxTimeoutMs ? 0 : kRelaxTimeoutMs - elapsed;
+        }
+
+        int ret = TEMP_FAILURE_RETRY(poll(pfds, 2, timeout));
+        if (ret < 0) {
+            PLOG(ERROR) << "Failed to poll PSI triggers";
+            return 1;
+        }
+
+        if (ret == 0) {
+            tuner.setLevel(static_cast<Level>(tuner.level() - 1), "quiet");
+            last_event = nowMs();
+            continue;
+        }
+
+        if ((pfds[0].revents | pfds[1].revents) & POLLERR) {
+            LOG(ERROR) << "PSI triggers were removed";
+            return 1;
+        }
+
+        Level level = (pfds[1].revents & POLLPRI) ? HIGH : MEDIUM;
+        tuner.setLevel(std::max(level, tuner.level()),
+                       level == HIGH ? "full stall" : "some stall");
+        last_event = nowMs();
+    }
+}
@@ -22,6 +22,7 @@ import android.content.Context;
 import android.content.Intent;
 import android.util.Log;
 import org.lineageos.settings.popupcamera.PopupCameraUtils;
+import org.lineageos.settings.power.ForegroundAppReporter;
 
 public class BootCompletedReceiver extends BroadcastReceiver {
     private static final boolean DEBUG = false;
@@ -32,5 +33,6 @@ public class BootCompletedReceiver extends BroadcastReceiver {
         if (DEBUG)
             Log.d(TAG, "Received boot completed intent");
         PopupCameraUtils.startService(context);
+        ForegroundAppReporter.register();
     }
 }
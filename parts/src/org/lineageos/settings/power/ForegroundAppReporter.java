@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.lineageos.settings.power;
+
+import android.app.ActivityManager.RunningTaskInfo;
+import android.app.ActivityTaskManager;
+import android.app.TaskStackListener;
+import android.content.ComponentName;
+import android.os.RemoteException;
+import android.os.SystemProperties;
+import android.util.Log;
+
+/**
+ * Reports the package of the foreground task to the power HAL, which applies
+ * its per-app profile.
+ */
+public class ForegroundAppReporter extends TaskStackListener {
+    private static final String TAG = "ForegroundAppReporter";
+    private static final boolean DEBUG = false;
+
+    private static final String FOREGROUND_APP_PROP = "vendor.power.fg_app";
+
+    private String mLastPackage;
+
+    public static void register() {
+        try {
+            ActivityTaskManager.getService().registerTaskStackListener(
+                    new ForegroundAppReporter());
+        } catch (RemoteException e) {
+            Log.e(TAG, "Failed to register task stack listener", e);
+        }
+    }
+
+    @Override
+    public void onTaskMovedToFront(RunningTaskInfo taskInfo) {
+        ComponentName top = taskInfo.topActivity;
+        if (top == null) {
+            return;
+        }
+
+        String packageName = top.getPackageName();
+        if (packageName.equals(mLastPackage)) {
+            return;
+        }
+        mLastPackage = packageName;
+
+        if (DEBUG)
+            Log.d(TAG, "Foreground app: " + packageName);
+        SystemProperties.set(FOREGROUND_APP_PROP, packageName);
+    }
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "post_boot"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+#include <glob.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::android::base::ReadFileToString;
+using ::android::base::Split;
+using ::android::base::Trim;
+using ::android::base::WriteStringToFile;
+
+namespace {
+
+constexpr const char* kTablePath = "/vendor/etc/post_boot.conf";
+constexpr const char* kLmkAdjPath = "/sys/module/lowmemorykiller/parameters/adj";
+constexpr const char* kLmkAdjMaxShiftPath = "/sys/module/lowmemorykiller/parameters/adj_max_shift";
+
+using Clock = std::chrono::steady_clock;
+
+struct Write {
+    std::string pattern;
+    std::string value;
+};
+
+struct Group {
+    std::string name;
+    std::vector<std::string> after;
+    std::vector<Write> writes;
+    // Only the first write whose node exists is applied.
+    bool first = false;
+    int wave = -1;
+
+    // Filled in while applying.
+    size_t written = 0;
+    size_t failed = 0;
+    size_t mismatched = 0;
+    size_t missing = 0;
+    std::chrono::microseconds elapsed{0};
+};
+
+// Collapses runs of whitespace so "95 95" matches a node reading back "95\t95".
+std::string normalize(const std::string& value) {
+    std::istringstream ss(value);
+    std::string word, out;
+    while (ss >> word) out += (out.empty() ? "" : " ") + word;
+    return out;
+}
+
+std::vector<std::string> resolve(const std::string& pattern) {
+    std::vector<std::string> paths;
+    glob_t g;
+    if (glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc; i++) paths.emplace_back(g.gl_pathv[i]);
+    }
+    globfree(&g);
+    return paths;
+}
+
+bool load(const std::string& path, const std::string& root, std::vector<Group>* groups) {
+    std::string content;
+    if (!ReadFileToString(path, &content)) {
+        PLOG(ERROR) << "Failed to read " << path;
+        return false;
+    }
+
+    for (auto line : Split(content, "\n")) {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        std::istringstream ss(line);
+        std::string key;
+        ss >> key;
+        if (key == "group") {
+            Group group;
+            ss >> group.name;
+            std::string word;
+            while (ss >> word) {
+                if (word == "first") {
+                    group.first = true;
+                } else if (word == "after") {
+                    while (ss >> word) group.after.push_back(word);
+                }
+            }
+            groups->push_back(std::move(group));
+            continue;
+        }
+
+        std::string value;
+        std::getline(ss, value);
+        value = Trim(value);
+        if (groups->empty() || value.empty()) {
+            LOG(ERROR) << "Ignoring malformed line: " << line;
+            continue;
+        }
+
+        groups->back().writes.push_back({root + key, value});
+    }
+    return true;
+}
+
+// Orders groups into waves: a group runs in the wave after the last of the
+// groups it depends on. Returns the number of waves, or -1 on a cycle.
+int schedule(std::vector<Group>* groups) {
+    std::map<std::string, Group*> by_name;
+    for (auto& group : *groups) by_name[group.name] = &group;
+
+    int waves = 0;
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (auto& group : *groups) {
+            if (group.wave >= 0) continue;
+
+            int wave = 0;
+            bool ready = true;
+            for (const auto& dep : group.after) {
+                auto it = by_name.find(dep);
+                if (it == by_name.end()) {
+                    LOG(WARNING) << group.name << " depends on unknown group " << dep;
+                    continue;
+                }
+                if (it->second->wave < 0) {
+                    ready = false;
+                    break;
+                }
+                wave = std::max(wave, it->second->wave + 1);
+            }
+            if (!ready) continue;
+
+            group.wave = wave;
+            waves = std::max(waves, wave + 1);
+            progress = true;
+        }
+    }
+
+    for (const auto& group : *groups) {
+        if (group.wave < 0) {
+            LOG(ERROR) << "Dependency cycle involving group " << group.name;
+            return -1;
+        }
+    }
+    return waves;
+}
+
+void apply(Group* group) {
+    auto start = Clock::now();
+    for (const auto& write : group->writes) {
+        // Expanded right before writing, an earlier write in the group (e.g.
+        // a devfreq governor) may have created the nodes.
+        std::vector<std::string> paths = resolve(write.pattern);
+        if (paths.empty()) {
+            group->missing++;
+            continue;
+        }
+        for (const auto& path : paths) {
+            group->written++;
+            if (!WriteStringToFile(write.value, path)) {
+                PLOG(ERROR) << "Failed to write " << write.value << " to " << path;
+                group->failed++;
+                continue;
+            }
+
+            std::string readback;
+            if (ReadFileToString(path, &readback) &&
+                normalize(readback) != normalize(write.value)) {
+                LOG(WARNING) << path << " reads back \"" << Trim(readback) << "\" instead of \""
+                             << write.value << "\"";
+                group->mismatched++;
+            }
+        }
+        if (group->first) break;
+    }
+    group->elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+}
+
+// PPR and ALMK should not act on HOME adj and below. The normalized adj of
+// HOME is 6, and the adj series is only known at runtime.
+void applyLmkAdjMaxShift(const std::string& root) {
+    std::string adj;
+    if (!ReadFileToString(root + kLmkAdjPath, &adj)) return;
+
+    auto series = Split(Trim(adj), ",");
+    if (series.size() < 2) return;
+    int shift = atoi(series[1].c_str()) * 6 + 6;
+    if (!WriteStringToFile(std::to_string(shift), root + kLmkAdjMaxShiftPath)) {
+        PLOG(ERROR) << "Failed to write " << shift << " to " << kLmkAdjMaxShiftPath;
+    }
+}
+
+// Applies a table, with root prepended to every node. Returns the exit status.
+int run(const std::string& table, const std::string& root) {
+    auto start = Clock::now();
+    std::vector<Group> groups;
+    if (!load(table, root, &groups)) return 1;
+    int waves = schedule(&groups);
+    if (waves < 0) return 1;
+    auto loaded = Clock::now();
+
+    for (int wave = 0; wave < waves; wave++) {
+        std::vector<std::thread> threads;
+        for (auto& group : groups) {
+            if (group.wave == wave) threads.emplace_back(apply, &group);
+        }
+        for (auto& thread : threads) thread.join();
+    }
+    applyLmkAdjMaxShift(root);
+
+    auto us = [](Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    };
+    size_t written = 0, failed = 0, mismatched = 0;
+    std::chrono::microseconds serial{0};
+    for (const auto& group : groups) {
+        LOG(INFO) << "  " << group.name << " (wave " << group.wave << "): " << group.written
+                  << " writes, " << group.failed << " failed, " << group.mismatched
+                  << " mismatched, " << group.missing << " missing in " << group.elapsed.count()
+                  << "us";
+        written += group.written;
+        failed += group.failed;
+        mismatched += group.mismatched;
+        serial += group.elapsed;
+    }
+    LOG(INFO) << "Applied " << written << " writes (" << failed << " failed, " << mismatched
+              << " mismatched) from " << groups.size() << " groups in " << waves << " waves: "
+              << us(loaded - start) << "us loading, " << us(Clock::now() - loaded)
+              << "us applying, " << serial.count() << "us if serial";
+
+    if (root.empty()) {
+        ::android::base::SetProperty("vendor.post_boot.parsed", "1");
+    }
+    return failed ? 1 : 0;
+}
+
+}  // anonymous namespace
+
+// Usage: post_boot [table] [root]
+// A root prefix is prepended to every node, so a table can be exercised
+// against a fake sysfs tree off-device.
+int main(int argc, char** argv) {
+    return run(argc > 1 ? argv[1] : kTablePath, argc > 2 ? argv[2] : "");
+}
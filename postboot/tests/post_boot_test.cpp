@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Built together with the code under test, so the helpers in its anonymous
+// namespace are visible here. Its main() would clash with gtest's.
+#define main post_boot_main
+#include "../post_boot.cpp"
+#undef main
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+namespace {
+
+// A fake sysfs tree in a temporary directory, used as the root prefix.
+class PostBootTest : public ::testing::Test {
+  protected:
+    std::string root() const { return dir_.path; }
+
+    void mkdirs(const std::string& path) {
+        std::string dir = root();
+        for (const auto& part : Split(path, "/")) {
+            if (part.empty()) continue;
+            dir += "/" + part;
+            mkdir(dir.c_str(), 0755);
+        }
+    }
+
+    // Creates a node holding the given value, and its parent directories.
+    void node(const std::string& path, const std::string& value = "0") {
+        mkdirs(path.substr(0, path.rfind('/')));
+        ASSERT_TRUE(WriteStringToFile(value, root() + path));
+    }
+
+    std::string read(const std::string& path) {
+        std::string value;
+        if (!ReadFileToString(root() + path, &value)) return "<missing>";
+        return value;
+    }
+
+    std::vector<Group> load(const std::string& table) {
+        TemporaryFile file;
+        EXPECT_TRUE(WriteStringToFile(table, file.path));
+        std::vector<Group> groups;
+        EXPECT_TRUE(::load(file.path, root(), &groups));
+        return groups;
+    }
+
+    int run(const std::string& table) {
+        TemporaryFile file;
+        EXPECT_TRUE(WriteStringToFile(table, file.path));
+        return ::run(file.path, root());
+    }
+
+    static int wave(const std::vector<Group>& groups, const std::string& name) {
+        for (const auto& group : groups) {
+            if (group.name == name) return group.wave;
+        }
+        ADD_FAILURE() << "No group " << name;
+        return -2;
+    }
+
+    TemporaryDir dir_;
+};
+
+}  // anonymous namespace
+
+TEST_F(PostBootTest, ParsesGroups) {
+    auto groups = load(R"(
+# comment
+group sched
+/proc/sys/kernel/sched_upmigrate 95 95   # trailing comment
+/proc/sys/kernel/sched_boost 0
+
+group cpuset first after sched lmk
+/dev/cpuset/a 0-3
+
+/no/value
+)");
+    ASSERT_EQ(groups.size(), 2u);
+
+    EXPECT_EQ(groups[0].name, "sched");
+    EXPECT_FALSE(groups[0].first);
+    EXPECT_TRUE(groups[0].after.empty());
+    ASSERT_EQ(groups[0].writes.size(), 2u);
+    EXPECT_EQ(groups[0].writes[0].pattern, root() + "/proc/sys/kernel/sched_upmigrate");
+    EXPECT_EQ(groups[0].writes[0].value, "95 95");
+
+    EXPECT_EQ(groups[1].name, "cpuset");
+    EXPECT_TRUE(groups[1].first);
+    EXPECT_EQ(groups[1].after, (std::vector<std::string>{"sched", "lmk"}));
+    // The malformed line is dropped.
+    ASSERT_EQ(groups[1].writes.size(), 1u);
+    EXPECT_EQ(groups[1].writes[0].value, "0-3");
+}
+
+TEST_F(PostBootTest, WritesBeforeAnyGroupAreIgnored) {
+    auto groups = load("/proc/sys/kernel/sched_boost 0\ngroup a\n");
+    ASSERT_EQ(groups.size(), 1u);
+    EXPECT_TRUE(groups[0].writes.empty());
+}
+
+TEST_F(PostBootTest, SchedulesWaves) {
+    auto groups = load(R"(
+group c after a b
+group b after a
+group a
+group d
+group e after c d
+)");
+    EXPECT_EQ(schedule(&groups), 4);
+    EXPECT_EQ(wave(groups, "a"), 0);
+    EXPECT_EQ(wave(groups, "d"), 0);
+    EXPECT_EQ(wave(groups, "b"), 1);
+    EXPECT_EQ(wave(groups, "c"), 2);
+    EXPECT_EQ(wave(groups, "e"), 3);
+}
+
+TEST_F(PostBootTest, UnknownDependencyIsIgnored) {
+    auto groups = load("group a after missing\ngroup b after a missing\n");
+    EXPECT_EQ(schedule(&groups), 2);
+    EXPECT_EQ(wave(groups, "a"), 0);
+    EXPECT_EQ(wave(groups, "b"), 1);
+}
+
+TEST_F(PostBootTest, CycleIsRejected) {
+    auto groups = load("group a after c\ngroup b after a\ngroup c after b\ngroup d\n");
+    EXPECT_EQ(schedule(&groups), -1);
+
+    node("/sys/x");
+    EXPECT_EQ(run("group a after b\n/sys/x 1\ngroup b after a\n"), 1);
+    EXPECT_EQ(read("/sys/x"), "0");
+}
+
+TEST_F(PostBootTest, GlobsExpandAtWriteTime) {
+    node("/sys/class/devfreq/soc:qcom,cpu-llcc/governor", "performance");
+    auto groups = load(R"(
+group devfreq
+/sys/class/devfreq/*/governor bw_hwmon
+/sys/class/devfreq/*/bw_hwmon/sample_ms 4
+)");
+    ASSERT_EQ(schedule(&groups), 1);
+
+    // Appears after loading, like tunables created by a governor switch.
+    node("/sys/class/devfreq/soc:qcom,cpu-llcc/bw_hwmon/sample_ms");
+    apply(&groups[0]);
+    EXPECT_EQ(groups[0].written, 2u);
+    EXPECT_EQ(groups[0].missing, 0u);
+    EXPECT_EQ(read("/sys/class/devfreq/soc:qcom,cpu-llcc/governor"), "bw_hwmon");
+    EXPECT_EQ(read("/sys/class/devfreq/soc:qcom,cpu-llcc/bw_hwmon/sample_ms"), "4");
+}
+
+TEST_F(PostBootTest, GlobWritesEveryMatch) {
+    node("/sys/cpu0/min");
+    node("/sys/cpu1/min");
+    node("/sys/cpu2/max");
+    EXPECT_EQ(run("group cpus\n/sys/cpu*/min 300\n"), 0);
+    EXPECT_EQ(read("/sys/cpu0/min"), "300");
+    EXPECT_EQ(read("/sys/cpu1/min"), "300");
+    EXPECT_EQ(read("/sys/cpu2/max"), "0");
+}
+
+TEST_F(PostBootTest, MissingNodesAreSkipped) {
+    node("/sys/b");
+    auto groups = load("group g\n/sys/a 1\n/sys/b 2\n");
+    apply(&groups[0]);
+    EXPECT_EQ(groups[0].missing, 1u);
+    EXPECT_EQ(groups[0].written, 1u);
+    EXPECT_EQ(read("/sys/a"), "<missing>");
+    EXPECT_EQ(read("/sys/b"), "2");
+}
+
+TEST_F(PostBootTest, FirstGroupStopsAtFirstExistingNode) {
+    node("/sys/b");
+    node("/sys/c");
+    auto groups = load("group g first\n/sys/a 1\n/sys/b 2\n/sys/c 3\n");
+    apply(&groups[0]);
+    EXPECT_EQ(groups[0].missing, 1u);
+    EXPECT_EQ(groups[0].written, 1u);
+    EXPECT_EQ(read("/sys/b"), "2");
+    EXPECT_EQ(read("/sys/c"), "0");
+}
+
+TEST_F(PostBootTest, LaterWavesSeeEarlierWrites) {
+    node("/sys/a");
+    node("/sys/b");
+    EXPECT_EQ(run("group second after first\n/sys/a 2\ngroup first\n/sys/a 1\n/sys/b 1\n"), 0);
+    EXPECT_EQ(read("/sys/a"), "2");
+    EXPECT_EQ(read("/sys/b"), "1");
+}
+
+TEST_F(PostBootTest, LmkAdjMaxShiftFollowsAdjSeries) {
+    node("/sys/module/lowmemorykiller/parameters/adj", "0,1,2,4,9,12\n");
+    node("/sys/module/lowmemorykiller/parameters/adj_max_shift");
+    EXPECT_EQ(run("group empty\n"), 0);
+    EXPECT_EQ(read("/sys/module/lowmemorykiller/parameters/adj_max_shift"), "12");
+}
+
+TEST(PostBootNormalizeTest, CollapsesWhitespace) {
+    EXPECT_EQ(normalize("95\t95\n"), "95 95");
+    EXPECT_EQ(normalize("  1  2 "), "1 2");
+    EXPECT_EQ(normalize(""), "");
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <sys/system_properties.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "power-profile.h"
+#include "touch-boost.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Per-package overrides for the foreground app, loaded from a table:
+//
+//   app com.example.game
+//   touch_boost 400 3000
+//   /sys/devices/system/cpu/cpufreq/policy4/scaling_min_freq 1612800
+//   /dev/cpuset/top-app/cpus 4-7
+//
+// "touch_boost <down ms> <max ms>" overrides the touch boost durations, any
+// other line is a node value. Numeric values are floors on top of the mode
+// profiles, others replace them. The foreground package is reported through
+// the vendor.power.fg_app property.
+class AppProfiles {
+  public:
+    static constexpr const char* kProfilePath = "/vendor/etc/power_app_profiles.conf";
+    static constexpr const char* kForegroundAppProp = "vendor.power.fg_app";
+
+    static AppProfiles& get() {
+        static AppProfiles instance(kProfilePath);
+        return instance;
+    }
+
+    // Starts following the foreground app, once.
+    void start() {
+        std::call_once(started_, [this] {
+            if (!profiles_.empty()) std::thread(&AppProfiles::watchLoop, this).detach();
+        });
+    }
+
+  private:
+    static constexpr const char* kLayer = "APP_PROFILE";
+    // Above LAUNCH and GAME, below LOW_POWER and the thermal caps. Numbers
+    // only ever raise what LAUNCH and GAME set, so a profile never weakens a
+    // boost.
+    static constexpr int kPriority = 65;
+
+    struct Profile {
+        std::vector<std::pair<std::string, std::string>> values;
+        std::chrono::milliseconds touch_down{0};
+        std::chrono::milliseconds touch_max{0};
+    };
+
+    explicit AppProfiles(const std::string& path) { load(path); }
+
+    void load(const std::string& path) {
+        std::string content;
+        if (!::android::base::ReadFileToString(path, &content)) {
+            PLOG(ERROR) << "Failed to read " << path;
+            return;
+        }
+
+        Profile* profile = nullptr;
+        for (auto line : ::android::base::Split(content, "\n")) {
+            line = ::android::base::Trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+
+            std::istringstream ss(line);
+            std::string key;
+            ss >> key;
+            if (key == "app") {
+                std::string package;
+                ss >> package;
+                profile = &profiles_[package];
+                continue;
+            }
+            if (!profile) {
+                LOG(ERROR) << "Ignoring app profile line outside of an app: " << line;
+                continue;
+            }
+            if (key == "touch_boost") {
+                int down = 0, max = 0;
+                ss >> down >> max;
+                profile->touch_down = std::chrono::milliseconds(down);
+                profile->touch_max = std::chrono::milliseconds(max);
+                continue;
+            }
+
+            std::string value;
+            std::getline(ss, value);
+            profile->values.emplace_back(key, ::android::base::Trim(value));
+        }
+
+        LOG(INFO) << "Loaded " << profiles_.size() << " app profiles";
+    }
+
+    void apply(const std::string& package) {
+        auto it = profiles_.find(package);
+        const Profile* profile = it == profiles_.end() ? nullptr : &it->second;
+        if (profile == current_) return;
+
+        auto start = std::chrono::steady_clock::now();
+        if (profile) {
+            // Replacing the values of an active layer only writes the
+            // difference, in one batch under the profile lock.
+            PowerProfile::get().addLayer(kLayer, kPriority, profile->values,
+                                         PowerProfile::Combine::kMax);
+            PowerProfile::get().setLayer(kLayer, true, false);
+            TouchBoost::get().setDurations(profile->touch_down, profile->touch_max);
+        } else {
+            PowerProfile::get().setLayer(kLayer, false, false);
+            TouchBoost::get().setDurations({}, {});
+        }
+        current_ = profile;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+        LOG(INFO) << "App profile " << (profile ? package : "default") << " applied in "
+                  << elapsed.count() << "us";
+    }
+
+    void watchLoop() {
+        const prop_info* pi;
+        uint32_t serial = __system_property_area_serial();
+        while (!(pi = __system_property_find(kForegroundAppProp))) {
+            __system_property_wait(nullptr, serial, &serial, nullptr);
+        }
+
+        serial = __system_property_serial(pi);
+        while (true) {
+            std::string package;
+            __system_property_read_callback(
+                    pi,
+                    [](void* cookie, const char*, const char* value, uint32_t) {
+                        *static_cast<std::string*>(cookie) = value;
+                    },
+                    &package);
+            apply(package);
+            __system_property_wait(pi, serial, &serial, nullptr);
+        }
+    }
+
+    std::once_flag started_;
+    std::map<std::string, Profile> profiles_;
+    // Only touched by the watch thread.
+    const Profile* current_ = nullptr;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
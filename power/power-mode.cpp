@@ -16,7 +16,20 @@
 
 #include <aidl/android/hardware/power/BnPower.h>
 #include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
 #include <linux/input.h>
+#include <sys/system_properties.h>
+
+#include <mutex>
+#include <thread>
+
+#include "app-profiles.h"
+#include "power-profile.h"
+#include "power-stats.h"
+#include "thermal-governor.h"
+#include "touch-boost.h"
+#include "touch-device.h"
 
 namespace aidl {
 namespace android {
@@ -32,30 +45,94 @@ using ::aidl::android::hardware::power::Mode;
 bool isDeviceSpecificModeSupported(Mode type, bool* _aidl_return) {
     switch (type) {
         case Mode::DOUBLE_TAP_TO_WAKE:
+        case Mode::SUSTAINED_PERFORMANCE:
             *_aidl_return = true;
             return true;
         default:
+            if (PowerProfile::get().hasLayer(toString(type))) {
+                *_aidl_return = true;
+                return true;
+            }
             return false;
     }
 }
 
-bool setDeviceSpecificMode(Mode type, bool enabled) {
+static bool applyDeviceSpecificMode(Mode type, bool enabled) {
     switch (type) {
-        case Mode::DOUBLE_TAP_TO_WAKE: {
-            int fd = open("/dev/input/event3", O_RDWR);
-            struct input_event ev;
-            ev.type = EV_SYN;
-            ev.code = SYN_CONFIG;
-            ev.value = enabled ? kInputEventWakeupModeOn : kInputEventWakeupModeOff;
-            write(fd, &ev, sizeof(ev));
-            close(fd);
-	    return true;
-        }
+        case Mode::DOUBLE_TAP_TO_WAKE:
+            TouchDevice::get().sendConfig(enabled ? kInputEventWakeupModeOn
+                                                  : kInputEventWakeupModeOff);
+            return true;
+        case Mode::SUSTAINED_PERFORMANCE:
+            PowerProfile::get().setLayer(toString(type), enabled);
+            ThermalGovernor::get().setEnabled(enabled);
+            return true;
+        case Mode::INTERACTIVE:
+            // Keep the common interactive handling on top of our profile.
+            PowerProfile::get().setLayer(toString(type), enabled);
+            TouchBoost::get().setEnabled(enabled);
+            AppProfiles::get().start();
+            return false;
         default:
+            // Profile layers only add node values, the common HAL still does
+            // its own handling (e.g. the GPU hint for EXPENSIVE_RENDERING).
+            PowerProfile::get().setLayer(toString(type), enabled);
             return false;
     }
 }
 
+// The common HAL implements no dump() that device specific code could add
+// to, so the stats are dumped to logcat and a file on request. The shell may
+// set the property, so this works on user builds too:
+//
+//   adb shell setprop vendor.power.dump 1
+//   adb logcat -d | grep -A 40 'Power mode/boost stats'
+//
+// The file copy, /data/vendor/power/dump.txt, is only readable as root.
+static constexpr const char* kDumpProp = "vendor.power.dump";
+static constexpr const char* kDumpPath = "/data/vendor/power/dump.txt";
+
+static void dumpDeviceSpecificStats() {
+    std::string out;
+    PowerStats::get().dump(&out);
+    TouchBoost::get().dump(&out);
+
+    for (const auto& line : ::android::base::Split(out, "\n")) {
+        if (!line.empty()) LOG(INFO) << line;
+    }
+    if (!::android::base::WriteStringToFile(out, kDumpPath)) {
+        PLOG(ERROR) << "Failed to write " << kDumpPath;
+    }
+}
+
+static void dumpLoop() {
+    const prop_info* pi = __system_property_find(kDumpProp);
+    bool created = !pi;
+    uint32_t serial = __system_property_area_serial();
+    while (!pi) {
+        __system_property_wait(nullptr, serial, &serial, nullptr);
+        pi = __system_property_find(kDumpProp);
+    }
+
+    serial = __system_property_serial(pi);
+    if (created) dumpDeviceSpecificStats();
+    while (true) {
+        __system_property_wait(pi, serial, &serial, nullptr);
+        dumpDeviceSpecificStats();
+    }
+}
+
+bool setDeviceSpecificMode(Mode type, bool enabled) {
+    static std::once_flag dump_started;
+    std::call_once(dump_started, [] { std::thread(dumpLoop).detach(); });
+
+    auto start = std::chrono::steady_clock::now();
+    bool handled = applyDeviceSpecificMode(type, enabled);
+    PowerStats::get().recordMode(toString(type), enabled,
+                                 std::chrono::steady_clock::now() - start);
+    return handled;
+}
+
 }  // namespace impl
 }  // namespace power
 }  // namespace hardware
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Sysfs/procfs values grouped into named layers (one per power mode), loaded
+// from a declarative profile file:
+//
+//   # mode <name> <priority>
+//   mode LAUNCH 60
+//   /sys/devices/system/cpu/cpufreq/policy0/scaling_min_freq 1209600
+//
+// Paths may contain glob patterns, they are resolved once at load time. Every
+// node is opened once. A node follows the highest priority active layer that
+// sets it, and goes back to the value it held before when none does. Layers
+// added at runtime may instead only raise or only lower a numeric value set by
+// the active layers below them.
+//
+// post_boot, perfd and thermal-engine write the same nodes, so nothing is
+// cached: a node is read back before every write. The value to restore is
+// captured when a layer takes the node over, and is replaced by anything
+// another writer puts there meanwhile. If the node no longer holds the
+// layer's value when the last layer lets go, the other writer's value is
+// left alone.
+class PowerProfile {
+  public:
+    static constexpr const char* kProfilePath = "/vendor/etc/power_profiles.conf";
+
+    // How a layer's value combines with the one of the active layers below.
+    enum class Combine {
+        // Replaces it.
+        kOverride,
+        // Takes the larger number, e.g. for frequency floors.
+        kMax,
+        // Takes the smaller number, e.g. for frequency caps.
+        kMin,
+    };
+
+    static PowerProfile& get() {
+        static PowerProfile instance(kProfilePath);
+        return instance;
+    }
+
+    bool hasLayer(const std::string& name) {
+        std::lock_guard<std::mutex> lock(lock_);
+        return layers_.count(name);
+    }
+
+    // Enables or disables a layer and applies the resulting node values as
+    // one batch. Returns false if the layer is unknown. Layers toggled at a
+    // high rate pass log = false.
+    bool setLayer(const std::string& name, bool enabled, bool log = true) {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        auto it = layers_.find(name);
+        if (it == layers_.end()) {
+            return false;
+        }
+        if (active_.count(name) == enabled) {
+            return true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (enabled) {
+            active_.insert(name);
+        } else {
+            active_.erase(name);
+        }
+
+        std::vector<size_t> touched;
+        for (const auto& [node, value] : it->second.values) {
+            touched.push_back(node);
+        }
+        size_t writes = applyLocked(touched);
+
+        if (!log) return true;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+        LOG(INFO) << "Power profile " << name << (enabled ? " on" : " off") << ": " << writes
+                  << " writes in " << elapsed.count() << "us";
+        return true;
+    }
+
+    // Registers a layer at runtime, replacing any previous one of that name.
+    // A replaced layer keeps its active state and only the difference between
+    // the old and new values is written.
+    void addLayer(const std::string& name, int priority,
+                  const std::vector<std::pair<std::string, std::string>>& values,
+                  Combine combine = Combine::kOverride) {
+        std::lock_guard<std::mutex> lock(lock_);
+        applyLocked(addLayerLocked(name, priority, values, combine));
+    }
+
+  private:
+    struct Layer {
+        int priority = 0;
+        Combine combine = Combine::kOverride;
+        std::vector<std::pair<size_t, std::string>> values;
+    };
+
+    explicit PowerProfile(const std::string& path) { load(path); }
+
+    // Returns the nodes whose effective value may have changed.
+    std::vector<size_t> addLayerLocked(
+            const std::string& name, int priority,
+            const std::vector<std::pair<std::string, std::string>>& values,
+            Combine combine = Combine::kOverride) {
+        std::vector<size_t> touched = detachLayerLocked(name);
+
+        Layer& layer = layers_[name];
+        layer.priority = priority;
+        layer.combine = combine;
+        for (const auto& [pattern, value] : values) {
+            for (const auto& path : resolve(pattern)) {
+                size_t node = nodeIndexLocked(path);
+                layer.values.emplace_back(node, value);
+                auto& setters = nodes_[node].setters;
+                setters.emplace_back(name, value);
+                std::stable_sort(setters.begin(), setters.end(), [this](auto& a, auto& b) {
+                    return layers_[a.first].priority > layers_[b.first].priority;
+                });
+                touched.push_back(node);
+            }
+        }
+        return touched;
+    }
+
+    // Drops a layer's values without touching its active state or the nodes.
+    std::vector<size_t> detachLayerLocked(const std::string& name) {
+        std::vector<size_t> touched;
+        auto it = layers_.find(name);
+        if (it == layers_.end()) return touched;
+
+        for (const auto& [node, value] : it->second.values) {
+            auto& setters = nodes_[node].setters;
+            setters.erase(std::remove_if(setters.begin(), setters.end(),
+                                         [&](auto& s) { return s.first == name; }),
+                          setters.end());
+            touched.push_back(node);
+        }
+        layers_.erase(it);
+        return touched;
+    }
+
+    // Brings the given nodes to their effective values, returns the number
+    // of writes issued.
+    size_t applyLocked(std::vector<size_t> touched) {
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+        std::vector<std::pair<size_t, std::string>> failed;
+        size_t writes = 0;
+        for (size_t node : touched) {
+            Node& n = nodes_[node];
+            std::optional<std::string> want = effectiveLocked(node);
+            if (!want && !n.baseline) continue;
+
+            std::optional<std::string> current = readNode(n);
+            if (!current) continue;
+
+            if (want) {
+                if (!n.baseline || !sameValue(*current, n.written)) n.baseline = current;
+            } else {
+                std::string baseline = *n.baseline;
+                n.baseline.reset();
+                if (!sameValue(*current, n.written)) {
+                    LOG(INFO) << n.path << " was changed to " << *current
+                              << ", not restoring " << baseline;
+                    continue;
+                }
+                want = baseline;
+            }
+
+            if (sameValue(*current, *want)) {
+                n.written = *current;
+                continue;
+            }
+            writes++;
+            if (writeNode(n, *want)) {
+                n.written = *want;
+            } else {
+                failed.emplace_back(node, *want);
+            }
+        }
+
+        // Interdependent nodes (e.g. min/max frequency) may need the other
+        // side written first, so give the failed ones a second chance.
+        for (const auto& [node, want] : failed) {
+            Node& n = nodes_[node];
+            writes++;
+            if (writeNode(n, want)) {
+                n.written = want;
+            } else {
+                PLOG(ERROR) << "Failed to write " << want << " to " << n.path;
+            }
+        }
+
+        return writes;
+    }
+
+    struct Node {
+        std::string path;
+        ::android::base::unique_fd fd;
+        // Value to restore, set while a layer holds the node.
+        std::optional<std::string> baseline;
+        // Last value written or seen by a layer write.
+        std::string written;
+        // (layer, value) pairs, highest priority first.
+        std::vector<std::pair<std::string, std::string>> setters;
+    };
+
+    static std::vector<std::string> resolve(const std::string& pattern) {
+        std::vector<std::string> paths;
+        glob_t g;
+        if (glob(pattern.c_str(), GLOB_NOSORT, nullptr, &g) == 0) {
+            for (size_t i = 0; i < g.gl_pathc; i++) paths.emplace_back(g.gl_pathv[i]);
+        }
+        globfree(&g);
+        if (paths.empty()) {
+            LOG(WARNING) << "Power profile node " << pattern << " not found";
+        }
+        return paths;
+    }
+
+    void load(const std::string& path) {
+        std::string content;
+        if (!::android::base::ReadFileToString(path, &content)) {
+            PLOG(ERROR) << "Failed to read " << path;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string layer;
+        int priority = 0;
+        std::vector<std::pair<std::string, std::string>> values;
+        auto flush = [&] {
+            if (!layer.empty()) addLayerLocked(layer, priority, values);
+            values.clear();
+        };
+
+        for (auto line : ::android::base::Split(content, "\n")) {
+            line = ::android::base::Trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+
+            std::istringstream ss(line);
+            std::string key;
+            ss >> key;
+            if (key == "mode") {
+                flush();
+                ss >> layer >> priority;
+                continue;
+            }
+
+            std::string value;
+            std::getline(ss, value);
+            value = ::android::base::Trim(value);
+            if (layer.empty() || value.empty()) {
+                LOG(ERROR) << "Ignoring malformed power profile line: " << line;
+                continue;
+            }
+            values.emplace_back(key, value);
+        }
+        flush();
+
+        LOG(INFO) << "Loaded " << layers_.size() << " power profiles over " << nodes_.size()
+                  << " nodes";
+    }
+
+    size_t nodeIndexLocked(const std::string& path) {
+        auto it = node_index_.find(path);
+        if (it != node_index_.end()) return it->second;
+
+        Node node;
+        node.path = path;
+        node.fd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDWR | O_CLOEXEC)));
+        if (node.fd < 0) {
+            PLOG(ERROR) << "Failed to open " << path;
+        }
+        nodes_.push_back(std::move(node));
+        node_index_[path] = nodes_.size() - 1;
+        return nodes_.size() - 1;
+    }
+
+    // Folds the active setters from the lowest priority up. A non-numeric
+    // value always replaces, whatever the layer's combine mode.
+    std::optional<std::string> effectiveLocked(size_t node) {
+        const auto& setters = nodes_[node].setters;
+        std::optional<std::string> value;
+        for (auto it = setters.rbegin(); it != setters.rend(); ++it) {
+            if (!active_.count(it->first)) continue;
+
+            Combine combine = layers_[it->first].combine;
+            std::optional<double> a, b;
+            if (value && combine != Combine::kOverride) {
+                a = parseNumber(*value);
+                b = parseNumber(it->second);
+            }
+            if (!a || !b || (combine == Combine::kMax ? *b > *a : *b < *a)) {
+                value = it->second;
+            }
+        }
+        return value;
+    }
+
+    static std::optional<double> parseNumber(const std::string& value) {
+        char* end;
+        double number = strtod(value.c_str(), &end);
+        if (end == value.c_str() || *end) return std::nullopt;
+        return number;
+    }
+
+    // Compares node values by whitespace separated words, numbers by value,
+    // so "40" matches a cpu.uclamp.min reading back "40.00".
+    static bool sameValue(const std::string& a, const std::string& b) {
+        std::istringstream sa(a), sb(b);
+        std::string wa, wb;
+        while (true) {
+            bool more_a = static_cast<bool>(sa >> wa);
+            bool more_b = static_cast<bool>(sb >> wb);
+            if (!more_a || !more_b) return more_a == more_b;
+            if (wa == wb) continue;
+
+            char *end_a, *end_b;
+            double da = strtod(wa.c_str(), &end_a);
+            double db = strtod(wb.c_str(), &end_b);
+            if (*end_a || *end_b || end_a == wa.c_str() || end_b == wb.c_str() || da != db) {
+                return false;
+            }
+        }
+    }
+
+    static std::optional<std::string> readNode(const Node& node) {
+        if (node.fd < 0) return std::nullopt;
+
+        char buf[256];
+        ssize_t len = TEMP_FAILURE_RETRY(pread(node.fd, buf, sizeof(buf) - 1, 0));
+        if (len < 0) {
+            PLOG(ERROR) << "Failed to read " << node.path;
+            return std::nullopt;
+        }
+        return ::android::base::Trim(std::string(buf, len));
+    }
+
+    static bool writeNode(const Node& node, const std::string& value) {
+        return TEMP_FAILURE_RETRY(pwrite(node.fd, value.c_str(), value.size(), 0)) >= 0;
+    }
+
+    std::mutex lock_;
+    std::map<std::string, Layer> layers_;
+    std::set<std::string> active_;
+    std::vector<Node> nodes_;
+    std::map<std::string, size_t> node_index_;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Per mode/boost counters: entries, cumulative residency, when it was last
+// applied and how long it took from the hint to the sysfs writes being done.
+// Reported through dump() and periodically flushed to a binary stats file.
+class PowerStats {
+  public:
+    static constexpr const char* kStatsPath = "/data/vendor/power/stats.bin";
+
+    static PowerStats& get() {
+        // Never destroyed, the flush thread uses it until the process exits.
+        static PowerStats* instance = new PowerStats();
+        return *instance;
+    }
+
+    // A mode was entered or left; latency is the time spent applying it.
+    void recordMode(const std::string& name, bool enabled, std::chrono::nanoseconds latency) {
+        std::lock_guard<std::mutex> lock(lock_);
+        Entry& e = entries_[name];
+        uint64_t now = nowNs();
+        if (enabled && !e.active) {
+            e.active = true;
+            e.entries++;
+            e.entered_ns = now;
+        } else if (!enabled && e.active) {
+            e.active = false;
+            e.residency_ns += now - e.entered_ns;
+        }
+        recordLatencyLocked(e, now, latency);
+    }
+
+    // A boost of the given duration was applied.
+    void recordBoost(const std::string& name, std::chrono::nanoseconds duration,
+                     std::chrono::nanoseconds latency) {
+        std::lock_guard<std::mutex> lock(lock_);
+        Entry& e = entries_[name];
+        e.entries++;
+        e.residency_ns += duration.count();
+        recordLatencyLocked(e, nowNs(), latency);
+    }
+
+    void dump(std::string* out) {
+        std::lock_guard<std::mutex> lock(lock_);
+        uint64_t now = nowNs();
+        ::android::base::StringAppendF(out, "Power mode/boost stats:\n");
+        for (const auto& [name, e] : entries_) {
+            ::android::base::StringAppendF(
+                    out,
+                    "  %s: %s entries=%" PRIu64 " residency=%" PRIu64 "ms last=%" PRIu64
+                    "ms ago latency avg=%" PRIu64 "us max=%" PRIu64 "us\n",
+                    name.c_str(), e.active ? "active" : "idle", e.entries,
+                    residencyNs(e, now) / 1000000, (now - e.last_applied_ns) / 1000000,
+                    e.latency_count ? e.latency_total_ns / e.latency_count / 1000 : 0,
+                    e.latency_max_ns / 1000);
+        }
+    }
+
+  private:
+    static constexpr auto kFlushInterval = std::chrono::minutes(10);
+    static constexpr uint32_t kMagic = 0x54535750;  // "PWST"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kNameLen = 32;
+
+    struct Entry {
+        bool active = false;
+        uint64_t entries = 0;
+        uint64_t entered_ns = 0;
+        uint64_t residency_ns = 0;
+        uint64_t last_applied_ns = 0;
+        uint64_t latency_count = 0;
+        uint64_t latency_total_ns = 0;
+        uint64_t latency_max_ns = 0;
+    };
+
+    // On-disk layout: a FileHeader followed by FileRecord[count], all
+    // little-endian, timestamps in CLOCK_BOOTTIME ns.
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+        uint32_t reserved;
+        uint64_t timestamp_ns;
+    } __attribute__((packed));
+
+    struct FileRecord {
+        char name[kNameLen];
+        uint64_t entries;
+        uint64_t residency_ns;
+        uint64_t last_applied_ns;
+        uint64_t latency_count;
+        uint64_t latency_total_ns;
+        uint64_t latency_max_ns;
+    } __attribute__((packed));
+
+    PowerStats() { std::thread(&PowerStats::flushLoop, this).detach(); }
+
+    static uint64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    static uint64_t residencyNs(const Entry& e, uint64_t now) {
+        return e.residency_ns + (e.active ? now - e.entered_ns : 0);
+    }
+
+    void recordLatencyLocked(Entry& e, uint64_t now, std::chrono::nanoseconds latency) {
+        e.last_applied_ns = now;
+        e.latency_count++;
+        e.latency_total_ns += latency.count();
+        e.latency_max_ns = std::max<uint64_t>(e.latency_max_ns, latency.count());
+        dirty_ = true;
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(lock_);
+        while (true) {
+            flush_cv_.wait_for(lock, kFlushInterval);
+            if (!dirty_) continue;
+
+            std::string data = serializeLocked();
+            dirty_ = false;
+
+            lock.unlock();
+            writeStatsFile(data);
+            lock.lock();
+        }
+    }
+
+    std::string serializeLocked() {
+        uint64_t now = nowNs();
+        FileHeader header{kMagic, kVersion, static_cast<uint32_t>(entries_.size()), 0, now};
+        std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& [name, e] : entries_) {
+            FileRecord record{};
+            strncpy(record.name, name.c_str(), kNameLen - 1);
+            record.entries = e.entries;
+            record.residency_ns = residencyNs(e, now);
+            record.last_applied_ns = e.last_applied_ns;
+            record.latency_count = e.latency_count;
+            record.latency_total_ns = e.latency_total_ns;
+            record.latency_max_ns = e.latency_max_ns;
+            data.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        return data;
+    }
+
+    static void writeStatsFile(const std::string& data) {
+        // Write a temporary file and rename it so readers never see a partial one.
+        std::string tmp = std::string(kStatsPath) + ".tmp";
+        if (!::android::base::WriteStringToFile(data, tmp) || rename(tmp.c_str(), kStatsPath)) {
+            PLOG(ERROR) << "Failed to write " << kStatsPath;
+        }
+    }
+
+    std::mutex lock_;
+    std::condition_variable flush_cv_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "power-profile.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Runtime layers over temporary files standing in for the sysfs nodes. Layer
+// names are unique per test, since the profile is a process wide singleton.
+class PowerProfileTest : public ::testing::Test {
+  protected:
+    using Combine = PowerProfile::Combine;
+
+    PowerProfileTest() { ::android::base::WriteStringToFile("2841600", node_.path); }
+
+    std::string layer(const char* name) {
+        return std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) +
+               "_" + name;
+    }
+
+    void add(const char* name, int priority, const std::string& value,
+             Combine combine = Combine::kOverride) {
+        PowerProfile::get().addLayer(layer(name), priority, {{node_.path, value}}, combine);
+    }
+
+    void set(const char* name, bool enabled) {
+        EXPECT_TRUE(PowerProfile::get().setLayer(layer(name), enabled, false));
+    }
+
+    std::string node() {
+        std::string value;
+        ::android::base::ReadFileToString(node_.path, &value);
+        return value;
+    }
+
+    TemporaryFile node_;
+};
+
+TEST_F(PowerProfileTest, HigherPriorityOverrides) {
+    add("LOW_POWER", 80, "1612800");
+    add("FIXED", 100, "1209600");
+    set("LOW_POWER", true);
+    set("FIXED", true);
+    EXPECT_EQ(node(), "1209600");
+    set("FIXED", false);
+    EXPECT_EQ(node(), "1612800");
+    set("LOW_POWER", false);
+    EXPECT_EQ(node(), "2841600");
+}
+
+TEST_F(PowerProfileTest, CapOnlyLowers) {
+    add("LOW_POWER", 80, "1612800");
+    add("CAP", 95, "2419200", Combine::kMin);
+
+    set("CAP", true);
+    EXPECT_EQ(node(), "2419200");
+    set("LOW_POWER", true);
+    EXPECT_EQ(node(), "1612800");
+    add("CAP", 95, "1401600", Combine::kMin);
+    EXPECT_EQ(node(), "1401600");
+    set("CAP", false);
+    EXPECT_EQ(node(), "1612800");
+    set("LOW_POWER", false);
+    EXPECT_EQ(node(), "2841600");
+}
+
+TEST_F(PowerProfileTest, FloorOnlyRaises) {
+    add("LAUNCH", 60, "2419200");
+    add("APP", 65, "1612800", Combine::kMax);
+
+    set("APP", true);
+    EXPECT_EQ(node(), "1612800");
+    set("LAUNCH", true);
+    EXPECT_EQ(node(), "2419200");
+    set("LAUNCH", false);
+    EXPECT_EQ(node(), "1612800");
+    set("APP", false);
+    EXPECT_EQ(node(), "2841600");
+}
+
+TEST_F(PowerProfileTest, HigherOverrideStillWins) {
+    add("APP", 65, "2419200", Combine::kMax);
+    add("FIXED", 100, "1612800");
+    set("APP", true);
+    set("FIXED", true);
+    EXPECT_EQ(node(), "1612800");
+}
+
+TEST_F(PowerProfileTest, NonNumericValueReplaces) {
+    ::android::base::WriteStringToFile("0-3", node_.path);
+    add("DEFAULT", 10, "0-5");
+    add("APP", 65, "0-7", Combine::kMax);
+    set("DEFAULT", true);
+    set("APP", true);
+    EXPECT_EQ(node(), "0-7");
+    set("APP", false);
+    EXPECT_EQ(node(), "0-5");
+    set("DEFAULT", false);
+    EXPECT_EQ(node(), "0-3");
+}
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "touch-boost.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <sstream>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+using namespace std::chrono_literals;
+
+// Replays recorded touch packets into a TouchBoost whose layer drives a
+// temporary file instead of the CPU nodes.
+class TouchBoostTest : public ::testing::Test {
+  protected:
+    using Clock = TouchBoost::Clock;
+
+    static constexpr auto kMotionExtension = TouchBoost::kMotionExtension;
+
+    TouchBoostTest() : boost_(true) {
+        ::android::base::WriteStringToFile("0", node_.path);
+        PowerProfile::get().addLayer(TouchBoost::kLayer, TouchBoost::kPriority,
+                                     {{node_.path, "1"}});
+        boost_.setEnabled(true);
+    }
+
+    ~TouchBoostTest() { boost_.setEnabled(false); }
+
+    static struct input_event event(uint16_t type, uint16_t code, int32_t value) {
+        struct input_event ev {};
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        return ev;
+    }
+
+    // A packet as the touch driver reports it, ending in SYN_REPORT and
+    // optionally timestamped in us.
+    void packet(Clock::duration at, std::vector<struct input_event> events,
+                int64_t stamp_us = 0) {
+        events.push_back(event(EV_SYN, SYN_REPORT, 0));
+        for (auto& ev : events) {
+            ev.input_event_sec = stamp_us / 1000000;
+            ev.input_event_usec = stamp_us % 1000000;
+        }
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        boost_.handleEventsLocked(events.data(), events.size(), t0_ + at);
+    }
+
+    void down(Clock::duration at) {
+        packet(at, {event(EV_KEY, BTN_TOUCH, 1), event(EV_ABS, ABS_MT_POSITION_X, 100),
+                    event(EV_ABS, ABS_MT_POSITION_Y, 200)});
+    }
+
+    void move(Clock::duration at) { packet(at, {event(EV_ABS, ABS_MT_POSITION_Y, 300)}); }
+
+    void up(Clock::duration at) { packet(at, {event(EV_KEY, BTN_TOUCH, 0)}); }
+
+    struct Replayed {
+        Clock::duration at;
+        bool boosted;
+    };
+
+    // Feeds `getevent -t` output packet by packet at its recorded times, with
+    // t0_ at the first event. Returns each packet's time and the boost state
+    // right after it.
+    std::vector<Replayed> replay(const std::string& capture) {
+        std::vector<Replayed> packets;
+        std::vector<struct input_event> events;
+        std::istringstream in(capture);
+        std::string line;
+        int64_t first_us = -1;
+        while (std::getline(in, line)) {
+            int64_t sec, usec;
+            unsigned int type, code, value;
+            if (sscanf(line.c_str(), " [ %" SCNd64 ".%" SCNd64 "] %*[^:]: %x %x %x", &sec, &usec,
+                       &type, &code, &value) != 5) {
+                continue;
+            }
+            int64_t stamp_us = sec * 1000000 + usec;
+            if (first_us < 0) first_us = stamp_us;
+
+            struct input_event ev = event(type, code, static_cast<int32_t>(value));
+            ev.input_event_sec = sec;
+            ev.input_event_usec = usec;
+            events.push_back(ev);
+            if (type != EV_SYN || code != SYN_REPORT) continue;
+
+            // The poll timeout would have fired first if the boost ran out.
+            Clock::duration at = std::chrono::microseconds(stamp_us - first_us);
+            idle(at);
+            {
+                std::lock_guard<std::mutex> lock(boost_.lock_);
+                boost_.handleEventsLocked(events.data(), events.size(), t0_ + at);
+            }
+            events.clear();
+            packets.push_back({at, boosted()});
+        }
+        EXPECT_TRUE(events.empty()) << "Capture ends mid packet";
+        return packets;
+    }
+
+    // The poll timeout firing at the given time.
+    void idle(Clock::duration at) {
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        boost_.expireLocked(t0_ + at);
+    }
+
+    bool boosted() {
+        std::string value;
+        ::android::base::ReadFileToString(node_.path, &value);
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        EXPECT_EQ(value, boost_.boosted_ ? "1" : "0");
+        return boost_.boosted_;
+    }
+
+    uint64_t boosts() {
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        return boost_.boosts_;
+    }
+
+    uint64_t rateLimited() {
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        return boost_.rate_limited_;
+    }
+
+    std::chrono::nanoseconds latency() {
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        return boost_.latency_;
+    }
+
+    // As if EVIOCSCLOCKID had succeeded on the device.
+    void useMonotonicClock() {
+        std::lock_guard<std::mutex> lock(boost_.lock_);
+        boost_.monotonic_ = true;
+    }
+
+    TemporaryFile node_;
+    TouchBoost boost_;
+    const Clock::time_point t0_ = Clock::time_point(1h);
+};
+
+// A quick upward fling in `getevent -t` format, following the fts driver's
+// down, move and lift packets at its ~120Hz report rate, 117ms from finger to
+// lift. Written to that layout rather than captured on a device, a capture
+// from `getevent -t /dev/input/eventN` can be pasted in as is.
+constexpr const char* kFling = R"(
+[ 4086.215043] /dev/input/event2: 0003 0039 000001c7
+[ 4086.215043] /dev/input/event2: 0003 0035 0000021c
+[ 4086.215043] /dev/input/event2: 0003 0036 000006ae
+[ 4086.215043] /dev/input/event2: 0003 0030 0000000b
+[ 4086.215043] /dev/input/event2: 0001 014a 00000001
+[ 4086.215043] /dev/input/event2: 0001 0145 00000001
+[ 4086.215043] /dev/input/event2: 0000 0000 00000000
+[ 4086.223272] /dev/input/event2: 0003 0035 0000021b
+[ 4086.223272] /dev/input/event2: 0003 0036 000006aa
+[ 4086.223272] /dev/input/event2: 0000 0000 00000000
+[ 4086.231867] /dev/input/event2: 0003 0035 0000021c
+[ 4086.231867] /dev/input/event2: 0003 0036 0000069f
+[ 4086.231867] /dev/input/event2: 0000 0000 00000000
+[ 4086.240214] /dev/input/event2: 0003 0035 0000021e
+[ 4086.240214] /dev/input/event2: 0003 0036 00000688
+[ 4086.240214] /dev/input/event2: 0003 0030 0000000d
+[ 4086.240214] /dev/input/event2: 0000 0000 00000000
+[ 4086.248384] /dev/input/event2: 0003 0035 0000021e
+[ 4086.248384] /dev/input/event2: 0003 0036 0000065f
+[ 4086.248384] /dev/input/event2: 0000 0000 00000000
+[ 4086.256614] /dev/input/event2: 0003 0035 00000220
+[ 4086.256614] /dev/input/event2: 0003 0036 00000621
+[ 4086.256614] /dev/input/event2: 0000 0000 00000000
+[ 4086.265072] /dev/input/event2: 0003 0035 0000021e
+[ 4086.265072] /dev/input/event2: 0003 0036 000005cd
+[ 4086.265072] /dev/input/event2: 0000 0000 00000000
+[ 4086.273541] /dev/input/event2: 0003 0035 00000220
+[ 4086.273541] /dev/input/event2: 0003 0036 00000566
+[ 4086.273541] /dev/input/event2: 0000 0000 00000000
+[ 4086.282140] /dev/input/event2: 0003 0035 0000021e
+[ 4086.282140] /dev/input/event2: 0003 0036 000004f0
+[ 4086.282140] /dev/input/event2: 0000 0000 00000000
+[ 4086.290403] /dev/input/event2: 0003 0035 0000021d
+[ 4086.290403] /dev/input/event2: 0003 0036 00000472
+[ 4086.290403] /dev/input/event2: 0000 0000 00000000
+[ 4086.298995] /dev/input/event2: 0003 0035 0000021f
+[ 4086.298995] /dev/input/event2: 0003 0036 000003ef
+[ 4086.298995] /dev/input/event2: 0000 0000 00000000
+[ 4086.307186] /dev/input/event2: 0003 0035 0000021f
+[ 4086.307186] /dev/input/event2: 0003 0036 0000036a
+[ 4086.307186] /dev/input/event2: 0000 0000 00000000
+[ 4086.315579] /dev/input/event2: 0003 0035 00000220
+[ 4086.315579] /dev/input/event2: 0003 0036 000002ea
+[ 4086.315579] /dev/input/event2: 0000 0000 00000000
+[ 4086.323930] /dev/input/event2: 0003 0035 0000021e
+[ 4086.323930] /dev/input/event2: 0003 0036 00000273
+[ 4086.323930] /dev/input/event2: 0000 0000 00000000
+[ 4086.332400] /dev/input/event2: 0003 0039 ffffffff
+[ 4086.332400] /dev/input/event2: 0001 014a 00000000
+[ 4086.332400] /dev/input/event2: 0001 0145 00000000
+[ 4086.332400] /dev/input/event2: 0000 0000 00000000
+)";
+
+TEST_F(TouchBoostTest, TapBoostsUntilLift) {
+    down(0ms);
+    EXPECT_TRUE(boosted());
+    up(80ms);
+    EXPECT_FALSE(boosted());
+    EXPECT_EQ(boosts(), 1u);
+}
+
+TEST_F(TouchBoostTest, HoldEndsAfterDownDuration) {
+    down(0ms);
+    idle(249ms);
+    EXPECT_TRUE(boosted());
+    idle(250ms);
+    EXPECT_FALSE(boosted());
+}
+
+TEST_F(TouchBoostTest, MotionExtendsBoost) {
+    down(0ms);
+    move(200ms);
+    idle(300ms);
+    EXPECT_TRUE(boosted());
+    idle(350ms);
+    EXPECT_FALSE(boosted());
+}
+
+TEST_F(TouchBoostTest, ScrollCappedAtMaxDuration) {
+    down(0ms);
+    for (auto at = 100ms; at < 3s; at += 100ms) {
+        move(at);
+        idle(at);
+        if (at < 2s) {
+            EXPECT_TRUE(boosted()) << at.count() << "ms";
+        }
+    }
+    EXPECT_FALSE(boosted());
+    EXPECT_EQ(boosts(), 1u);
+}
+
+TEST_F(TouchBoostTest, FlingReplay) {
+    auto packets = replay(kFling);
+    ASSERT_EQ(packets.size(), 15u);
+    // Boosted from the touch-down through every move, until the lift.
+    for (size_t i = 0; i + 1 < packets.size(); i++) {
+        EXPECT_TRUE(packets[i].boosted) << "packet " << i;
+    }
+    EXPECT_FALSE(packets.back().boosted);
+    EXPECT_EQ(boosts(), 1u);
+    EXPECT_EQ(rateLimited(), 0u);
+}
+
+TEST_F(TouchBoostTest, FlingReplayWithoutLift) {
+    // A dropped lift packet leaves the boost to run out 150ms after the last
+    // move, past the touch-down duration.
+    std::string capture = kFling;
+    capture.erase(capture.rfind('\n', capture.find("0003 0039 ffffffff")));
+    auto packets = replay(capture);
+    ASSERT_EQ(packets.size(), 14u);
+    auto last = packets.back().at;
+    EXPECT_GT(last + kMotionExtension, 250ms);
+    idle(last + kMotionExtension - 1us);
+    EXPECT_TRUE(boosted());
+    idle(last + kMotionExtension);
+    EXPECT_FALSE(boosted());
+}
+
+TEST_F(TouchBoostTest, QuickTapsAreRateLimited) {
+    down(0ms);
+    up(50ms);
+    down(100ms);
+    EXPECT_FALSE(boosted());
+    EXPECT_EQ(rateLimited(), 1u);
+    up(150ms);
+    down(400ms);
+    EXPECT_TRUE(boosted());
+    EXPECT_EQ(boosts(), 2u);
+}
+
+TEST_F(TouchBoostTest, DisabledDoesNotBoost) {
+    boost_.setEnabled(false);
+    down(0ms);
+    EXPECT_FALSE(boosted());
+    EXPECT_EQ(boosts(), 0u);
+}
+
+TEST_F(TouchBoostTest, LatencyFromMonotonicTimestamp) {
+    useMonotonicClock();
+
+    // A touch-down stamped 3ms ago on CLOCK_MONOTONIC.
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    packet(0ms, {event(EV_KEY, BTN_TOUCH, 1)}, now.tv_sec * 1000000ll + now.tv_nsec / 1000 - 3000);
+    EXPECT_TRUE(boosted());
+    EXPECT_GE(latency(), 3ms);
+    EXPECT_LT(latency(), 1s);
+}
+
+TEST_F(TouchBoostTest, NoLatencyWithoutMonotonicClock) {
+    // CLOCK_REALTIME stamps would be decades off, they are not used at all.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    packet(0ms, {event(EV_KEY, BTN_TOUCH, 1)}, now.tv_sec * 1000000ll + now.tv_nsec / 1000);
+    EXPECT_TRUE(boosted());
+    EXPECT_EQ(latency(), 0ns);
+}
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
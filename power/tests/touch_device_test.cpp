@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "touch-device.h"
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// A memfd stands in for the evdev node and records every event written to it.
+class FakeInputDevice {
+  public:
+    explicit FakeInputDevice(const char* name) : fd_(memfd_create(name, MFD_CLOEXEC)) {}
+
+    ::android::base::unique_fd dup() const {
+        return ::android::base::unique_fd(fcntl(fd_, F_DUPFD_CLOEXEC, 0));
+    }
+
+    std::vector<int> configs() const {
+        std::vector<int> values;
+        struct input_event ev;
+        for (off_t off = 0; pread(fd_, &ev, sizeof(ev), off) == sizeof(ev); off += sizeof(ev)) {
+            EXPECT_EQ(ev.type, EV_SYN);
+            EXPECT_EQ(ev.code, SYN_CONFIG);
+            values.push_back(ev.value);
+        }
+        return values;
+    }
+
+  private:
+    ::android::base::unique_fd fd_;
+};
+
+class TouchDeviceTest : public ::testing::Test {
+  protected:
+    // No input directory to discover anything in, and no watch thread that
+    // could outlive the device.
+    TouchDeviceTest() : device_("/nonexistent", false) {}
+
+    void plug(const FakeInputDevice& input, const std::string& path) {
+        std::lock_guard<std::mutex> lock(device_.lock_);
+        device_.useDeviceLocked(input.dup(), path);
+    }
+
+    TouchDevice device_;
+};
+
+TEST_F(TouchDeviceTest, NoDevice) {
+    EXPECT_FALSE(device_.sendConfig(5));
+}
+
+TEST_F(TouchDeviceTest, RepeatedConfigIsNotResent) {
+    FakeInputDevice input("event0");
+    plug(input, "/dev/input/event0");
+
+    EXPECT_TRUE(device_.sendConfig(5));
+    EXPECT_TRUE(device_.sendConfig(5));
+    EXPECT_TRUE(device_.sendConfig(4));
+    EXPECT_TRUE(device_.sendConfig(4));
+    EXPECT_EQ(input.configs(), (std::vector<int>{5, 4}));
+}
+
+TEST_F(TouchDeviceTest, FeaturesReplayedOnNewDevice) {
+    FakeInputDevice first("event0");
+    plug(first, "/dev/input/event0");
+    EXPECT_TRUE(device_.sendConfig(5));
+    EXPECT_TRUE(device_.sendConfig(7));
+    EXPECT_TRUE(device_.sendConfig(6));
+
+    // Only the last state of each feature reaches the new device, and it is
+    // sent again even though the old device already had it.
+    FakeInputDevice second("event1");
+    plug(second, "/dev/input/event1");
+    EXPECT_EQ(second.configs(), (std::vector<int>{5, 6}));
+
+    EXPECT_TRUE(device_.sendConfig(5));
+    EXPECT_EQ(second.configs(), (std::vector<int>{5, 6}));
+    EXPECT_EQ(first.configs(), (std::vector<int>{5, 7, 6}));
+}
+
+TEST_F(TouchDeviceTest, WaitForDeviceReturnsNewDevice) {
+    FakeInputDevice input("event2");
+    plug(input, "/dev/input/event2");
+
+    uint64_t generation = 0;
+    EXPECT_EQ(device_.waitForDevice(&generation), "/dev/input/event2");
+    EXPECT_NE(generation, 0u);
+}
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "power-profile.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Caps the gold and gold+ clusters along a sustainable curve while
+// SUSTAINED_PERFORMANCE is active, so long sessions settle at a stable
+// frequency instead of hitting the thermal engine's throttling cliffs.
+class ThermalGovernor {
+  public:
+    static ThermalGovernor& get() {
+        static ThermalGovernor instance;
+        return instance;
+    }
+
+    void setEnabled(bool enabled) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (enabled == enabled_) return;
+        enabled_ = enabled;
+
+        if (enabled) {
+            step_ = 0;
+            skin_avg_ = cpu_avg_ = -1;
+            applyStepLocked();
+            if (!thread_.joinable()) thread_ = std::thread(&ThermalGovernor::loop, this);
+            cv_.notify_one();
+        } else {
+            PowerProfile::get().setLayer(kLayer, false);
+            LOG(INFO) << "Thermal governor stopped";
+        }
+    }
+
+  private:
+    static constexpr const char* kLayer = "THERMAL_GOVERNOR";
+    static constexpr int kPriority = 95;
+
+    static constexpr const char* kPolicy4Max =
+            "/sys/devices/system/cpu/cpufreq/policy4/scaling_max_freq";
+    static constexpr const char* kPolicy7Max =
+            "/sys/devices/system/cpu/cpufreq/policy7/scaling_max_freq";
+
+    // Thermal zones, by type.
+    static constexpr std::array<const char*, 4> kSkinZones = {"skin-therm-usr", "skin-therm",
+                                                              "quiet-therm-usr", "xo-therm-usr"};
+    static constexpr const char* kCpuZonePrefix = "cpu-1-";
+
+    static constexpr auto kPollInterval = std::chrono::seconds(1);
+    // Relaxing a cap waits this long after the last change.
+    static constexpr auto kStepUpDelay = std::chrono::seconds(5);
+    // Hysteresis for relaxing, in millidegrees.
+    static constexpr int kHysteresis = 1500;
+    // Weight of a new sample in the moving average, in 1/8ths.
+    static constexpr int kAvgWeight = 3;
+
+    // Sustainable curve: a step applies once either the skin or the hottest
+    // gold/gold+ core reaches its threshold (millidegrees Celsius).
+    struct Step {
+        int skin;
+        int cpu;
+        uint32_t policy4_max;
+        uint32_t policy7_max;
+    };
+    static constexpr std::array<Step, 7> kCurve = {{
+            {0, 0, 2419200, 2841600},
+            {38000, 75000, 2419200, 2419200},
+            {40000, 80000, 2227200, 2227200},
+            {42000, 85000, 2016000, 2016000},
+            {44000, 88000, 1804800, 1804800},
+            {46000, 91000, 1612800, 1612800},
+            {48000, 94000, 1401600, 1401600},
+    }};
+
+    ThermalGovernor() {
+        std::unique_ptr<DIR, decltype(&closedir)> dir(opendir("/sys/class/thermal"), closedir);
+        if (!dir) {
+            PLOG(ERROR) << "Failed to open /sys/class/thermal";
+            return;
+        }
+
+        int skin_rank = kSkinZones.size();
+        while (struct dirent* de = readdir(dir.get())) {
+            if (strncmp(de->d_name, "thermal_zone", 12)) continue;
+
+            std::string zone = std::string("/sys/class/thermal/") + de->d_name;
+            std::string type;
+            if (!::android::base::ReadFileToString(zone + "/type", &type)) continue;
+            type = ::android::base::Trim(type);
+
+            auto open_temp = [&] {
+                return ::android::base::unique_fd(TEMP_FAILURE_RETRY(
+                        open((zone + "/temp").c_str(), O_RDONLY | O_CLOEXEC)));
+            };
+            if (::android::base::StartsWith(type, kCpuZonePrefix)) {
+                cpu_fds_.push_back(open_temp());
+                continue;
+            }
+            for (int i = 0; i < skin_rank; i++) {
+                if (type == kSkinZones[i]) {
+                    skin_fd_ = open_temp();
+                    skin_rank = i;
+                    break;
+                }
+            }
+        }
+
+        LOG(INFO) << "Thermal governor using " << cpu_fds_.size() << " cpu zones, skin zone "
+                  << (skin_fd_ < 0 ? "missing" : kSkinZones[skin_rank]);
+    }
+
+    static int readTemp(int fd) {
+        char buf[16];
+        ssize_t len = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf) - 1, 0));
+        if (len <= 0) return -1;
+        buf[len] = '\0';
+        return atoi(buf);
+    }
+
+    static int average(int avg, int sample) {
+        if (sample < 0) return avg;
+        if (avg < 0) return sample;
+        return (avg * (8 - kAvgWeight) + sample * kAvgWeight) / 8;
+    }
+
+    // Step 0 is uncapped, so the layer is only on from step 1. Its caps only
+    // ever lower what the modes below it ask for, e.g. LOW_POWER's.
+    void applyStepLocked() {
+        if (step_ > 0) {
+            const Step& step = kCurve[step_];
+            PowerProfile::get().addLayer(kLayer, kPriority,
+                                         {{kPolicy4Max, std::to_string(step.policy4_max)},
+                                          {kPolicy7Max, std::to_string(step.policy7_max)}},
+                                         PowerProfile::Combine::kMin);
+        }
+        PowerProfile::get().setLayer(kLayer, step_ > 0);
+        last_change_ = std::chrono::steady_clock::now();
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(lock_);
+        while (true) {
+            cv_.wait(lock, [this] { return enabled_; });
+            cv_.wait_for(lock, kPollInterval);
+            if (!enabled_) continue;
+
+            int cpu = -1;
+            for (const auto& fd : cpu_fds_) cpu = std::max(cpu, readTemp(fd));
+            skin_avg_ = average(skin_avg_, skin_fd_ < 0 ? -1 : readTemp(skin_fd_));
+            cpu_avg_ = average(cpu_avg_, cpu);
+
+            // Highest step whose threshold is reached.
+            size_t target = 0;
+            for (size_t i = 1; i < kCurve.size(); i++) {
+                if (skin_avg_ >= kCurve[i].skin || cpu_avg_ >= kCurve[i].cpu) target = i;
+            }
+
+            size_t next = step_;
+            if (target > step_) {
+                next = target;
+            } else if (target < step_ &&
+                       std::chrono::steady_clock::now() - last_change_ >= kStepUpDelay &&
+                       skin_avg_ < kCurve[step_].skin - kHysteresis &&
+                       cpu_avg_ < kCurve[step_].cpu - kHysteresis) {
+                next = step_ - 1;
+            }
+            if (next == step_) continue;
+
+            LOG(INFO) << "Thermal governor: skin " << skin_avg_ << " cpu " << cpu_avg_
+                      << ", step " << step_ << " -> " << next << " (gold "
+                      << kCurve[next].policy4_max << ", gold+ " << kCurve[next].policy7_max
+                      << ")";
+            step_ = next;
+            applyStepLocked();
+        }
+    }
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool enabled_ = false;
+    size_t step_ = 0;
+    int skin_avg_ = -1;
+    int cpu_avg_ = -1;
+    std::chrono::steady_clock::time_point last_change_;
+    ::android::base::unique_fd skin_fd_;
+    std::vector<::android::base::unique_fd> cpu_fds_;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
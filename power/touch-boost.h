@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "power-profile.h"
+#include "power-stats.h"
+#include "touch-device.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// Boosts the CPUs on a touch-down after idle, before schedutil has ramped up
+// for the first frames. Motion keeps the boost alive up to a maximum, lifting
+// the finger ends it.
+class TouchBoost {
+  public:
+    static TouchBoost& get() {
+        static TouchBoost instance;
+        return instance;
+    }
+
+    void setEnabled(bool enabled) {
+        std::lock_guard<std::mutex> lock(lock_);
+        enabled_ = enabled;
+        if (!enabled) endBoostLocked();
+    }
+
+    // Overrides the touch-down and maximum boost durations, zero keeps the
+    // default.
+    void setDurations(std::chrono::milliseconds down, std::chrono::milliseconds max) {
+        std::lock_guard<std::mutex> lock(lock_);
+        down_duration_ = down.count() ? down : kDownDuration;
+        max_duration_ = max.count() ? max : kMaxDuration;
+    }
+
+    void dump(std::string* out) {
+        std::lock_guard<std::mutex> lock(lock_);
+        ::android::base::StringAppendF(out,
+                                       "Touch boost (%s): boosts=%" PRIu64
+                                       " rate_limited=%" PRIu64 " %s\n",
+                                       uclamp_ ? "uclamp" : "min freq", boosts_, rate_limited_,
+                                       boosted_ ? "active" : "idle");
+    }
+
+  private:
+    friend class TouchBoostTest;
+
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr const char* kLayer = "TOUCH_BOOST";
+    static constexpr int kPriority = 58;
+    static constexpr const char* kTopAppUclampMin = "/dev/cpuctl/top-app/cpu.uclamp.min";
+
+    // By default a touch-down boosts for kDownDuration, motion pushes the end
+    // out to kMotionExtension from the last move, never past kMaxDuration.
+    static constexpr auto kDownDuration = std::chrono::milliseconds(250);
+    static constexpr auto kMotionExtension = std::chrono::milliseconds(150);
+    static constexpr auto kMaxDuration = std::chrono::seconds(2);
+    // Touch-downs closer than this to the last boost start don't boost again.
+    static constexpr auto kMinInterval = std::chrono::milliseconds(300);
+
+    // Prefer boosting the top app through uclamp, and only pin cluster
+    // frequencies on kernels without it.
+    TouchBoost() : TouchBoost(access(kTopAppUclampMin, W_OK) == 0) {
+        std::thread(&TouchBoost::readLoop, this).detach();
+    }
+
+    // Only registers the boost layer, events are fed in by readLoop().
+    explicit TouchBoost(bool uclamp) : uclamp_(uclamp) {
+        if (uclamp_) {
+            PowerProfile::get().addLayer(kLayer, kPriority, {{kTopAppUclampMin, "40"}});
+        } else {
+            PowerProfile::get().addLayer(
+                    kLayer, kPriority,
+                    {{"/sys/devices/system/cpu/cpufreq/policy0/scaling_min_freq", "1209600"},
+                     {"/sys/devices/system/cpu/cpufreq/policy4/scaling_min_freq", "1056000"}});
+        }
+    }
+
+    // Only meaningful for events from a device switched to CLOCK_MONOTONIC.
+    static std::chrono::nanoseconds eventAge(const struct input_event& ev) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return std::chrono::seconds(now.tv_sec - ev.input_event_sec) +
+               std::chrono::nanoseconds(now.tv_nsec - ev.input_event_usec * 1000ll);
+    }
+
+    void onTouchDownLocked(const struct input_event& ev, Clock::time_point now) {
+        if (boosted_) {
+            deadline_ =
+                    std::min(std::max(deadline_, now + down_duration_), start_ + max_duration_);
+            return;
+        }
+        if (now - start_ < kMinInterval) {
+            rate_limited_++;
+            return;
+        }
+
+        boosted_ = true;
+        boosts_++;
+        start_ = now;
+        deadline_ = now + down_duration_;
+        PowerProfile::get().setLayer(kLayer, true, false);
+        latency_ = monotonic_ ? eventAge(ev) : std::chrono::nanoseconds(0);
+    }
+
+    void onMotionLocked(Clock::time_point now) {
+        if (!boosted_) return;
+        deadline_ = std::min(std::max(deadline_, now + kMotionExtension), start_ + max_duration_);
+    }
+
+    void expireLocked(Clock::time_point now) {
+        if (boosted_ && now >= deadline_) endBoostLocked(now);
+    }
+
+    void endBoostLocked(Clock::time_point now = Clock::now()) {
+        if (!boosted_) return;
+        boosted_ = false;
+        PowerProfile::get().setLayer(kLayer, false, false);
+        PowerStats::get().recordBoost(kLayer, now - start_, latency_);
+    }
+
+    // Tracks the touch state across packets and acts on each SYN_REPORT.
+    void handleEventsLocked(const struct input_event* events, size_t count,
+                            Clock::time_point now) {
+        for (size_t i = 0; i < count; i++) {
+            const struct input_event& ev = events[i];
+            if (ev.type == EV_KEY && ev.code == BTN_TOUCH) {
+                touched_ = ev.value && !down_;
+                lifted_ = !ev.value;
+                down_ = ev.value;
+            } else if (ev.type == EV_ABS &&
+                       (ev.code == ABS_MT_POSITION_X || ev.code == ABS_MT_POSITION_Y)) {
+                moved_ = true;
+            } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                if (enabled_) {
+                    if (touched_) {
+                        onTouchDownLocked(ev, now);
+                    } else if (lifted_) {
+                        endBoostLocked(now);
+                    } else if (moved_) {
+                        onMotionLocked(now);
+                    }
+                }
+                touched_ = lifted_ = moved_ = false;
+            }
+        }
+    }
+
+    void readLoop() {
+        uint64_t generation = 0;
+        while (true) {
+            std::string path = TouchDevice::get().waitForDevice(&generation);
+            ::android::base::unique_fd fd(
+                    TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+            if (fd < 0) {
+                PLOG(ERROR) << "Failed to open " << path;
+                continue;
+            }
+            LOG(INFO) << "Touch boost watching " << path;
+
+            // evdev timestamps events with CLOCK_REALTIME unless asked for
+            // another clock, which eventAge() can't compare against.
+            int clock = CLOCK_MONOTONIC;
+            bool monotonic = ioctl(fd, EVIOCSCLOCKID, &clock) == 0;
+            if (!monotonic) {
+                PLOG(ERROR) << "Failed to switch " << path << " to CLOCK_MONOTONIC";
+            }
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                monotonic_ = monotonic;
+                down_ = touched_ = lifted_ = moved_ = false;
+            }
+            readEvents(fd);
+
+            std::lock_guard<std::mutex> lock(lock_);
+            endBoostLocked();
+        }
+    }
+
+    // Returns once the device goes away.
+    void readEvents(int fd) {
+        struct input_event events[64];
+        while (true) {
+            int timeout = -1;
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (boosted_) {
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline_ - Clock::now());
+                    timeout = std::max<int>(left.count(), 0);
+                }
+            }
+
+            struct pollfd pfd = {fd, POLLIN, 0};
+            int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeout));
+            if (ret < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) return;
+
+            std::lock_guard<std::mutex> lock(lock_);
+            if (ret == 0) {
+                expireLocked(Clock::now());
+                continue;
+            }
+
+            ssize_t len = TEMP_FAILURE_RETRY(read(fd, events, sizeof(events)));
+            if (len < 0) {
+                if (errno == EAGAIN) continue;
+                PLOG(ERROR) << "Failed to read touch events";
+                return;
+            }
+
+            handleEventsLocked(events, len / sizeof(events[0]), Clock::now());
+        }
+    }
+
+    std::mutex lock_;
+    bool enabled_ = false;
+    bool uclamp_ = false;
+    bool boosted_ = false;
+    bool monotonic_ = false;
+    bool down_ = false, touched_ = false, lifted_ = false, moved_ = false;
+    std::chrono::milliseconds down_duration_ = kDownDuration;
+    std::chrono::milliseconds max_duration_ = kMaxDuration;
+    Clock::time_point start_;
+    Clock::time_point deadline_;
+    std::chrono::nanoseconds latency_{0};
+    uint64_t boosts_ = 0;
+    uint64_t rate_limited_ = 0;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+// The touchscreen input device, located by name and capabilities instead of
+// by its event node number. The fd is kept open and the device is looked up
+// again whenever /dev/input changes.
+class TouchDevice {
+  public:
+    static TouchDevice& get() {
+        static TouchDevice instance;
+        return instance;
+    }
+
+    // Sends a SYN_CONFIG event to the touch controller. Values come in off/on
+    // pairs (2n, 2n + 1) per feature, like 4/5 for double tap to wake, and
+    // repeating the state a feature was last set to on the current device is a
+    // no-op.
+    bool sendConfig(int value) {
+        std::lock_guard<std::mutex> lock(lock_);
+        return sendConfigLocked(value);
+    }
+
+    // Blocks until a touchscreen other than the one seen at *generation is
+    // in use, and returns its path.
+    std::string waitForDevice(uint64_t* generation) {
+        std::unique_lock<std::mutex> lock(lock_);
+        device_cv_.wait(lock, [&] { return generation_ != *generation && fd_ >= 0; });
+        *generation = generation_;
+        return path_;
+    }
+
+  private:
+    friend class TouchDeviceTest;
+
+    static constexpr const char* kInputDir = "/dev/input";
+    static constexpr std::array<const char*, 3> kTouchNames = {"fts", "fts_ts", "goodix_ts"};
+
+    TouchDevice() : TouchDevice(kInputDir, true) {}
+
+    TouchDevice(std::string input_dir, bool watch) : input_dir_(std::move(input_dir)) {
+        std::lock_guard<std::mutex> lock(lock_);
+        discoverLocked();
+        if (watch) {
+            watch_thread_ = std::thread(&TouchDevice::watchLoop, this);
+            watch_thread_.detach();
+        }
+    }
+
+    bool sendConfigLocked(int value) {
+        if (fd_ < 0) {
+            LOG(ERROR) << "No touchscreen to send SYN_CONFIG " << value << " to";
+            return false;
+        }
+        auto it = configs_.find(value / 2);
+        if (it != configs_.end() && it->second == value) {
+            return true;
+        }
+
+        struct input_event ev {};
+        ev.type = EV_SYN;
+        ev.code = SYN_CONFIG;
+        ev.value = value;
+        if (TEMP_FAILURE_RETRY(write(fd_, &ev, sizeof(ev))) != sizeof(ev)) {
+            PLOG(ERROR) << "Failed to send SYN_CONFIG " << value << " to " << path_;
+            return false;
+        }
+
+        configs_[value / 2] = value;
+        return true;
+    }
+
+    static bool testBit(const uint8_t* bits, int bit) {
+        return bits[bit / 8] & (1 << (bit % 8));
+    }
+
+    static bool isTouchscreen(int fd, bool* name_match) {
+        char name[80] = {};
+        if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0) {
+            return false;
+        }
+
+        *name_match = false;
+        for (auto touch_name : kTouchNames) {
+            if (!strcmp(name, touch_name)) *name_match = true;
+        }
+
+        uint8_t abs_bits[ABS_MAX / 8 + 1] = {};
+        uint8_t prop_bits[INPUT_PROP_MAX / 8 + 1] = {};
+        if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) < 0 ||
+            ioctl(fd, EVIOCGPROP(sizeof(prop_bits)), prop_bits) < 0) {
+            return false;
+        }
+
+        return testBit(abs_bits, ABS_MT_POSITION_X) && testBit(abs_bits, ABS_MT_POSITION_Y) &&
+               testBit(prop_bits, INPUT_PROP_DIRECT);
+    }
+
+    // Prefers a known controller name, otherwise takes the first direct
+    // multitouch device.
+    void discoverLocked() {
+        std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(input_dir_.c_str()), closedir);
+        if (!dir) {
+            PLOG(ERROR) << "Failed to open " << input_dir_;
+            return;
+        }
+
+        ::android::base::unique_fd found;
+        std::string found_path;
+        while (struct dirent* de = readdir(dir.get())) {
+            if (strncmp(de->d_name, "event", 5)) continue;
+
+            std::string path = input_dir_ + "/" + de->d_name;
+            ::android::base::unique_fd fd(
+                    TEMP_FAILURE_RETRY(open(path.c_str(), O_RDWR | O_CLOEXEC)));
+            if (fd < 0) continue;
+
+            bool name_match;
+            if (!isTouchscreen(fd, &name_match)) continue;
+            if (name_match || found < 0) {
+                found = std::move(fd);
+                found_path = path;
+            }
+            if (name_match) break;
+        }
+
+        if (found < 0) {
+            LOG(ERROR) << "No touchscreen found in " << input_dir_;
+            fd_.reset();
+            path_.clear();
+            return;
+        }
+
+        int version;
+        if (found_path != path_ || ioctl(fd_, EVIOCGVERSION, &version) < 0) {
+            useDeviceLocked(std::move(found), found_path);
+        }
+    }
+
+    void useDeviceLocked(::android::base::unique_fd fd, const std::string& path) {
+        LOG(INFO) << "Using touchscreen " << path;
+        fd_ = std::move(fd);
+        path_ = path;
+        generation_++;
+        device_cv_.notify_all();
+
+        // A new device starts with its defaults, replay every feature.
+        std::map<int, int> configs;
+        configs.swap(configs_);
+        for (const auto& [feature, value] : configs) sendConfigLocked(value);
+    }
+
+    void watchLoop() {
+        ::android::base::unique_fd ifd(inotify_init1(IN_CLOEXEC));
+        if (ifd < 0 ||
+            inotify_add_watch(ifd, input_dir_.c_str(), IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+            PLOG(ERROR) << "Failed to watch " << input_dir_;
+            return;
+        }
+
+        alignas(struct inotify_event) char buf[4096];
+        while (true) {
+            ssize_t len = TEMP_FAILURE_RETRY(read(ifd, buf, sizeof(buf)));
+            if (len <= 0) {
+                PLOG(ERROR) << "Failed to read inotify events";
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(lock_);
+            discoverLocked();
+        }
+    }
+
+    const std::string input_dir_;
+    std::mutex lock_;
+    std::condition_variable device_cv_;
+    ::android::base::unique_fd fd_;
+    std::string path_;
+    uint64_t generation_ = 0;
+    // Last value sent per feature.
+    std::map<int, int> configs_;
+    std::thread watch_thread_;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -21,7 +21,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -29,147 +28,367 @@
 #include <string>
 #include <vector>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "edify/expr.h"
 #include "otautil/error_code.h"
 
-#define MAX(a, b) (((a) > (b)) ? (a) : (b))
-
 #define ALPHABET_LEN 256
 
-#define XBL_PART_PATH "/dev/block/bootdevice/by-name/xbl_a"
-#define TZ_VER_STR "QC_IMAGE_VERSION_STRING=TZ."
-#define TZ_VER_STR_LEN 27
-#define TZ_VER_BUF_LEN 255
+#define PART_PATH(part) "/dev/block/bootdevice/by-name/" part
+#define VER_STR "QC_IMAGE_VERSION_STRING="
+#define VER_BUF_LEN 255
 
-/* Boyer-Moore string search implementation from Wikipedia */
+/* Firmware images and the version string each of them carries. Images
+ * sharing a partition are looked up in the same pass.
+ */
+struct firmware {
+    const char* function;
+    const char* image;
+    const char* part_path;
+    const char* lookup_str;
+    /* Bytes at the end of lookup_str that are reported as part of the version */
+    size_t version_tag_len;
+};
 
-/* Return longest suffix length of suffix ending at str[p] */
-static int max_suffix_len(const char* str, size_t str_len, size_t p) {
-    uint32_t i;
+/* ABL and DSP versions have always been reported with their build tag, the
+ * tag is only used to find the right string.
+ */
+static const struct firmware firmwares[] = {
+        {"xiaomi.verify_trustzone", "TZ", PART_PATH("xbl_a"), VER_STR "TZ.", 0},
+        {"xiaomi.verify_xbl", "XBL", PART_PATH("xbl_a"), VER_STR "BOOT.XF.", 0},
+        {"xiaomi.verify_abl", "ABL", PART_PATH("abl_a"), VER_STR "LE.UM.", sizeof("LE.UM.") - 1},
+        {"xiaomi.verify_modem", "modem", PART_PATH("modem_a"), VER_STR "MPSS.", 0},
+        {"xiaomi.verify_dsp", "DSP", PART_PATH("dsp_a"), VER_STR "ADSP.", sizeof("ADSP.") - 1},
+        {"xiaomi.verify_bluetooth", "bluetooth", PART_PATH("bluetooth_a"), VER_STR "BTFM.", 0},
+        {"xiaomi.verify_devcfg", "devcfg", PART_PATH("devcfg_a"), VER_STR "TZ.", 0},
+};
 
-    for (i = 0; (str[p - i] == str[str_len - 1 - i]) && (i < p);) {
-        i++;
-    }
+#define FIRMWARE_COUNT (sizeof(firmwares) / sizeof(firmwares[0]))
 
-    return i;
-}
+/* Versions found so far, kept for the rest of the updater run. Errors are
+ * negative errno values.
+ */
+static struct {
+    bool scanned;
+    int ret;
+    char version[VER_BUF_LEN];
+} results[FIRMWARE_COUNT];
 
-/* Generate table of distance between last character of pat and rightmost
- * occurrence of character c in pat
+/* Only positions where both the first and the last byte of the pattern
+ * match are candidates. These are found 16 at a time where SIMD is
+ * available, and only candidates get a full memcmp.
  */
-static void bm_make_delta1(int* delta1, const char* pat, size_t pat_len) {
-    uint32_t i;
-    for (i = 0; i < ALPHABET_LEN; i++) {
-        delta1[i] = pat_len;
+static char* simd_search(const char* str, size_t str_len, const char* pat, size_t pat_len) {
+    size_t i = 0;
+    size_t last, end;
+
+    if (pat_len == 0) {
+        return (char*)str;
     }
-    for (i = 0; i < pat_len - 1; i++) {
-        uint8_t idx = (uint8_t)pat[i];
-        delta1[idx] = pat_len - 1 - i;
+    if (pat_len > str_len) {
+        return NULL;
     }
+
+    last = pat_len - 1;
+    /* Number of positions the pattern can start at */
+    end = str_len - last;
+
+#if defined(__ARM_NEON)
+    const uint8x16_t first_v = vdupq_n_u8(pat[0]);
+    const uint8x16_t last_v = vdupq_n_u8(pat[last]);
+    for (; i + 16 <= end; i += 16) {
+        uint8x16_t eq = vandq_u8(vceqq_u8(first_v, vld1q_u8((const uint8_t*)str + i)),
+                                 vceqq_u8(last_v, vld1q_u8((const uint8_t*)str + i + last)));
+        /* Narrow the lanes to a 64 bit mask, 4 bits per position */
+        uint64_t mask = vget_lane_u64(
+                vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            int bit = __builtin_ctzll(mask) & ~3;
+            if (memcmp(str + i + bit / 4, pat, pat_len) == 0) {
+                return (char*)(str + i + bit / 4);
+            }
+            mask &= ~(0xfull << bit);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i first_v = _mm_set1_epi8(pat[0]);
+    const __m128i last_v = _mm_set1_epi8(pat[last]);
+    for (; i + 16 <= end; i += 16) {
+        __m128i eq = _mm_and_si128(
+                _mm_cmpeq_epi8(first_v, _mm_loadu_si128((const __m128i*)(str + i))),
+                _mm_cmpeq_epi8(last_v, _mm_loadu_si128((const __m128i*)(str + i + last))));
+        uint32_t mask = _mm_movemask_epi8(eq);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(str + i + bit, pat, pat_len) == 0) {
+                return (char*)(str + i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* Remaining positions, or all of them without SIMD */
+    while (i < end) {
+        const char* p = (const char*)memchr(str + i, pat[0], end - i);
+        if (p == NULL) {
+            break;
+        }
+        i = p - str;
+        if (str[i + last] == pat[last] && memcmp(str + i, pat, pat_len) == 0) {
+            return (char*)(str + i);
+        }
+        i++;
+    }
+
+    return NULL;
 }
 
-/* Generate table of next possible full match from mismatch at pat[p] */
-static void bm_make_delta2(int* delta2, const char* pat, size_t pat_len) {
-    int p;
-    uint32_t last_prefix = pat_len - 1;
+/* Aho-Corasick automaton, with the failure links folded into a full
+ * transition table so every byte costs a single lookup
+ */
+#define AC_MAX_PATTERNS 8
+#define AC_MAX_STATES 128
+
+struct ac_automaton {
+    uint8_t next[AC_MAX_STATES][ALPHABET_LEN];
+    /* Patterns ending in each state, as a bit mask */
+    uint32_t out[AC_MAX_STATES];
+    size_t states;
+};
+
+static int ac_build(struct ac_automaton* ac, const char* const* pats, size_t count) {
+    uint8_t fail[AC_MAX_STATES];
+    uint8_t queue[AC_MAX_STATES];
+    size_t head = 0, tail = 0;
+    size_t i, j;
+    int c;
 
-    for (p = pat_len - 1; p >= 0; p--) {
-        /* Compare whether pat[p-pat_len] is suffix of pat */
-        if (strncmp(pat + p, pat, pat_len - p) == 0) {
-            last_prefix = p + 1;
+    memset(ac, 0, sizeof(*ac));
+    ac->states = 1;
+
+    /* Trie of the patterns, 0 being the root and "no edge" alike */
+    for (i = 0; i < count; i++) {
+        uint8_t state = 0;
+        for (j = 0; pats[i][j]; j++) {
+            uint8_t* next = &ac->next[state][(uint8_t)pats[i][j]];
+            if (*next == 0) {
+                if (ac->states == AC_MAX_STATES) {
+                    return -E2BIG;
+                }
+                *next = ac->states++;
+            }
+            state = *next;
         }
-        delta2[p] = last_prefix + (pat_len - 1 - p);
+        ac->out[state] |= 1u << i;
     }
 
-    for (p = 0; p < (int)pat_len - 1; p++) {
-        /* Get longest suffix of pattern ending on character pat[p] */
-        int suf_len = max_suffix_len(pat, pat_len, p);
-        if (pat[p - suf_len] != pat[pat_len - 1 - suf_len]) {
-            delta2[pat_len - 1 - suf_len] = pat_len - 1 - p + suf_len;
+    /* Breadth first, a state's failure target is always complete before it */
+    fail[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        uint8_t state = queue[head++];
+        for (c = 0; c < ALPHABET_LEN; c++) {
+            uint8_t next = ac->next[state][c];
+            if (next == 0) {
+                ac->next[state][c] = state ? ac->next[fail[state]][c] : 0;
+                continue;
+            }
+            fail[next] = state ? ac->next[fail[state]][c] : 0;
+            ac->out[next] |= ac->out[fail[next]];
+            queue[tail++] = next;
         }
     }
+
+    return 0;
 }
 
-static char* bm_search(const char* str, size_t str_len, const char* pat, size_t pat_len) {
-    int delta1[ALPHABET_LEN];
-    int delta2[pat_len];
-    int i;
+/* Scan the partition in chunks of this size, so memory use stays bounded */
+#define SCAN_CHUNK_LEN (256 * 1024)
 
-    bm_make_delta1(delta1, pat, pat_len);
-    bm_make_delta2(delta2, pat, pat_len);
+/* Find the first occurrence of every pattern in a single pass, storing the
+ * offset right past it in ends, or -1. Every pattern starts with prefix, so
+ * whenever the automaton is back at its root the scan skips ahead to the
+ * next occurrence of prefix. Returns 0 or a negative errno.
+ */
+static int ac_scan(int fd, const struct ac_automaton* ac, size_t count, const char* prefix,
+                   size_t prefix_len, size_t max_len, off64_t* ends, off64_t* scanned) {
+    uint32_t all = (1u << count) - 1;
+    uint32_t found = 0;
+    uint8_t state = 0;
+    off64_t pos = 0;
+    char* buf;
+    size_t i, k;
+    ssize_t n;
 
-    if (pat_len == 0) {
-        return (char*)str;
+    *scanned = 0;
+    for (k = 0; k < count; k++) {
+        ends[k] = -1;
+    }
+
+    buf = (char*)malloc(SCAN_CHUNK_LEN);
+    if (buf == NULL) {
+        return -ENOMEM;
     }
 
-    i = pat_len - 1;
-    while (i < (int)str_len) {
-        int j = pat_len - 1;
-        while (j >= 0 && (str[i] == pat[j])) {
-            i--;
-            j--;
+    while (found != all) {
+        n = TEMP_FAILURE_RETRY(read(fd, buf, SCAN_CHUNK_LEN));
+        if (n < 0) {
+            int err = errno;
+            free(buf);
+            return -err;
         }
-        if (j < 0) {
-            return (char*)(str + i + 1);
+        if (n == 0) {
+            break;
         }
-        i += MAX(delta1[(uint8_t)str[i]], delta2[j]);
+        *scanned += n;
+
+        for (i = 0; i < (size_t)n && found != all;) {
+            if (state == 0 && prefix_len > 0) {
+                const char* p = simd_search(buf + i, n - i, prefix, prefix_len);
+                if (p != NULL) {
+                    i = p - buf;
+                } else if (n - i > max_len - 1) {
+                    /* Only the tail can start a match running into the next
+                     * chunk
+                     */
+                    i = n - (max_len - 1);
+                }
+            }
+            for (; i < (size_t)n; i++) {
+                state = ac->next[state][(uint8_t)buf[i]];
+                if (ac->out[state] & ~found) {
+                    for (k = 0; k < count; k++) {
+                        if ((ac->out[state] & ~found) & (1u << k)) {
+                            ends[k] = pos + i + 1;
+                        }
+                    }
+                    found |= ac->out[state];
+                    if (found == all) {
+                        break;
+                    }
+                }
+                if (state == 0) {
+                    i++;
+                    break;
+                }
+            }
+        }
+        pos += n;
     }
 
-    return NULL;
+    free(buf);
+    return 0;
 }
 
-static int get_info(char* str, size_t len, char* lookup_str, size_t lookup_str_len,
-                    char* part_path) {
+/* Look up the versions of all images in the partition of firmwares[idx] */
+static void scan_firmware(size_t idx) {
+    const char* part_path = firmwares[idx].part_path;
+    const char* pats[AC_MAX_PATTERNS];
+    size_t members[AC_MAX_PATTERNS];
+    off64_t ends[AC_MAX_PATTERNS];
+    struct ac_automaton* ac = NULL;
+    size_t count = 0, prefix_len = 0, max_len = 0;
+    off64_t scanned = 0;
+    size_t i, k;
     int ret = 0;
     int fd;
-    off64_t size;
-    char* data = NULL;
-    char* offset = NULL;
 
-    fd = open(part_path, O_RDONLY);
-    if (fd < 0) {
-        ret = errno;
-        goto err_ret;
+    for (i = 0; i < FIRMWARE_COUNT && count < AC_MAX_PATTERNS; i++) {
+        if (strcmp(firmwares[i].part_path, part_path) == 0) {
+            pats[count] = firmwares[i].lookup_str;
+            members[count++] = i;
+        }
     }
 
-    size = lseek64(fd, 0, SEEK_END);
-    if (size == -1) {
-        ret = errno;
-        goto err_fd_close;
+    /* Longest prefix shared by all patterns, and the longest pattern */
+    prefix_len = strlen(pats[0]);
+    for (k = 0; k < count; k++) {
+        size_t len = strlen(pats[k]);
+        size_t j = 0;
+        while (j < prefix_len && j < len && pats[k][j] == pats[0][j]) {
+            j++;
+        }
+        prefix_len = j;
+        max_len = len > max_len ? len : max_len;
     }
 
-    data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == (char*)-1) {
-        ret = errno;
-        goto err_fd_close;
+    fd = open(part_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ret = -errno;
+        goto done;
     }
 
-    /* Do Boyer-Moore search across data */
-    offset = bm_search(data, size, lookup_str, lookup_str_len);
-    if (offset != NULL) {
-        snprintf(str, len, "%s", offset + lookup_str_len);
-    } else {
-        ret = -ENOENT;
+    /* The scan only moves forward, let the kernel read ahead */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    ac = (struct ac_automaton*)malloc(sizeof(*ac));
+    if (ac == NULL) {
+        ret = -ENOMEM;
+        goto done;
+    }
+    ret = ac_build(ac, pats, count);
+    if (ret) {
+        goto done;
     }
+    ret = ac_scan(fd, ac, count, pats[0], prefix_len, max_len, ends, &scanned);
 
-    munmap(data, size);
-err_fd_close:
-    close(fd);
-err_ret:
-    return ret;
+done:
+    for (k = 0; k < count; k++) {
+        int r = ret;
+        char* version = results[members[k]].version;
+        if (r == 0 && ends[k] < 0) {
+            r = -ENOENT;
+        } else if (r == 0) {
+            /* The version string may run past the chunk, read it in one go */
+            off64_t start = ends[k] - firmwares[members[k]].version_tag_len;
+            ssize_t n = TEMP_FAILURE_RETRY(pread64(fd, version, VER_BUF_LEN - 1, start));
+            if (n < 0) {
+                r = -errno;
+                n = 0;
+            }
+            version[n] = '\0';
+        }
+        results[members[k]].scanned = true;
+        results[members[k]].ret = r;
+    }
+    fprintf(stderr, "Scanned %lld bytes of %s for %zu firmware versions: %d\n",
+            (long long)scanned, part_path, count, ret);
+
+    free(ac);
+    if (fd >= 0) {
+        close(fd);
+    }
 }
 
-/* verify_trustzone("TZ_VERSION", "TZ_VERSION", ...) */
-Value* VerifyTrustZoneFn(const char* name, State* state,
-                     const std::vector<std::unique_ptr<Expr>>& argv) {
-    char current_tz_version[TZ_VER_BUF_LEN];
+/* xiaomi.verify_<image>("VERSION", "VERSION", ...) */
+Value* VerifyFirmwareFn(const char* name, State* state,
+                        const std::vector<std::unique_ptr<Expr>>& argv) {
+    size_t idx;
     int ret;
 
-    ret = get_info(current_tz_version, TZ_VER_BUF_LEN, TZ_VER_STR, TZ_VER_STR_LEN,
-                   XBL_PART_PATH);
+    for (idx = 0; idx < FIRMWARE_COUNT; idx++) {
+        if (strcmp(firmwares[idx].function, name) == 0) {
+            break;
+        }
+    }
+    if (idx == FIRMWARE_COUNT) {
+        return ErrorAbort(state, kArgsParsingFailure, "%s() is not a firmware verifier", name);
+    }
+
+    if (!results[idx].scanned) {
+        scan_firmware(idx);
+    }
+    const char* current_version = results[idx].version;
+    ret = results[idx].ret;
     if (ret) {
-        return ErrorAbort(state, kFreadFailure,
-                          "%s() failed to read current TZ version: %d", name, ret);
+        return ErrorAbort(state, kFreadFailure, "%s() failed to read current %s version: %s",
+                          name, firmwares[idx].image, strerror(-ret));
     }
 
     std::vector<std::string> args;
@@ -178,8 +397,8 @@ Value* VerifyTrustZoneFn(const char* name, State* state,
     }
 
     ret = 0;
-    for (auto &tz_version : args) {
-        if (strncmp(tz_version.c_str(), current_tz_version, tz_version.length()) == 0) {
+    for (auto& version : args) {
+        if (strncmp(version.c_str(), current_version, version.length()) == 0) {
             ret = 1;
             break;
         }
@@ -189,5 +408,7 @@ Value* VerifyTrustZoneFn(const char* name, State* state,
 }
 
 void Register_librecovery_updater_raphael() {
-    RegisterFunction("xiaomi.verify_trustzone", VerifyTrustZoneFn);
+    for (size_t i = 0; i < FIRMWARE_COUNT; i++) {
+        RegisterFunction(firmwares[i].function, VerifyFirmwareFn);
+    }
 }
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// The subset of the edify interface recovery_updater.cpp uses, for host
+// builds of recovery_updater_test.cpp.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Expr {};
+struct State {};
+struct Value {};
+
+using Function = Value* (*)(const char* name, State* state,
+                            const std::vector<std::unique_ptr<Expr>>& argv);
+
+Value* ErrorAbort(State* state, int cause_code, const char* format, ...);
+bool ReadArgs(State* state, const std::vector<std::unique_ptr<Expr>>& argv,
+              std::vector<std::string>* args);
+Value* StringValue(const char* str);
+void RegisterFunction(const std::string& name, Function fn);
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Built together with the code under test, so the static search helpers are
+// visible here. Built once as is and once with the SIMD macros undefined, so
+// both the vector loop and the memchr fallback are covered.
+#include "../recovery_updater.cpp"
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <random>
+
+// The edify entry points the verifiers call, unused by these tests.
+Value* ErrorAbort(State*, int, const char*, ...) {
+    return nullptr;
+}
+
+bool ReadArgs(State*, const std::vector<std::unique_ptr<Expr>>&, std::vector<std::string>*) {
+    return false;
+}
+
+Value* StringValue(const char*) {
+    return nullptr;
+}
+
+void RegisterFunction(const std::string&, Function) {}
+
+namespace {
+
+// Haystacks over a small alphabet are full of partial matches.
+std::string random_string(std::mt19937* rng, size_t len, int alphabet) {
+    std::uniform_int_distribution<int> dist(0, alphabet - 1);
+    std::string s(len, '\0');
+    for (auto& c : s) c = static_cast<char>(alphabet == 256 ? dist(*rng) : 'a' + dist(*rng));
+    return s;
+}
+
+const char* expected_search(const std::string& str, const std::string& pat) {
+    return static_cast<const char*>(memmem(str.data(), str.size(), pat.data(), pat.size()));
+}
+
+void expect_search(const std::string& str, const std::string& pat) {
+    const char* found = simd_search(str.data(), str.size(), pat.data(), pat.size());
+    const char* expected = expected_search(str, pat);
+    EXPECT_EQ(found, expected) << "pattern \"" << pat << "\" (" << pat.size() << " bytes) in "
+                               << str.size() << " bytes, expected at "
+                               << (expected ? expected - str.data() : -1) << ", found at "
+                               << (found ? found - str.data() : -1);
+}
+
+// Scans data through a memfd the way scan_firmware() scans a partition.
+std::vector<off64_t> scan(const std::string& data, const std::vector<const char*>& pats) {
+    size_t count = pats.size();
+    size_t prefix_len = strlen(pats[0]), max_len = 0;
+    for (const char* pat : pats) {
+        size_t len = strlen(pat), j = 0;
+        while (j < prefix_len && j < len && pat[j] == pats[0][j]) j++;
+        prefix_len = j;
+        max_len = std::max(max_len, len);
+    }
+
+    auto ac = std::make_unique<ac_automaton>();
+    EXPECT_EQ(ac_build(ac.get(), pats.data(), count), 0);
+
+    int fd = memfd_create("partition", MFD_CLOEXEC);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+    lseek(fd, 0, SEEK_SET);
+
+    std::vector<off64_t> ends(count);
+    off64_t scanned = 0;
+    EXPECT_EQ(ac_scan(fd, ac.get(), count, pats[0], prefix_len, max_len, ends.data(), &scanned),
+              0);
+    close(fd);
+    return ends;
+}
+
+// Offsets right past the first occurrence of each pattern, or -1.
+std::vector<off64_t> expected_scan(const std::string& data, const std::vector<const char*>& pats) {
+    std::vector<off64_t> ends;
+    for (const char* pat : pats) {
+        const char* p = expected_search(data, pat);
+        ends.push_back(p ? p - data.data() + strlen(pat) : -1);
+    }
+    return ends;
+}
+
+const std::vector<const char*> kXblPatterns = {VER_STR "TZ.", VER_STR "BOOT.XF."};
+
+}  // anonymous namespace
+
+TEST(SimdSearchTest, EdgeCases) {
+    expect_search("", "");
+    expect_search("abc", "");
+    expect_search("", "a");
+    expect_search("ab", "abc");
+    expect_search("abc", "abc");
+    expect_search("abc", "c");
+    expect_search("abcabd", "abd");
+    // Candidates in the last lanes of a vector, and right after it.
+    for (size_t len = 1; len < 70; len++) {
+        for (size_t at = 0; at + 3 <= len; at++) {
+            std::string str(len, 'x');
+            str.replace(at, 3, "a-b");
+            expect_search(str, "a-b");
+            expect_search(str, "a-c");
+        }
+    }
+}
+
+TEST(SimdSearchTest, MatchesMemmemOnRandomInput) {
+    std::mt19937 rng(49);
+    for (int alphabet : {2, 4, 256}) {
+        for (int round = 0; round < 3000; round++) {
+            size_t str_len = std::uniform_int_distribution<size_t>(0, 300)(rng);
+            size_t pat_len = std::uniform_int_distribution<size_t>(1, 24)(rng);
+            std::string str = random_string(&rng, str_len, alphabet);
+            std::string pat = random_string(&rng, pat_len, alphabet);
+            expect_search(str, pat);
+            // A pattern that is known to occur, at an unaligned offset.
+            if (pat_len <= str_len) {
+                size_t at = std::uniform_int_distribution<size_t>(0, str_len - pat_len)(rng);
+                expect_search(str, str.substr(at, pat_len));
+            }
+        }
+    }
+}
+
+TEST(SimdSearchTest, MatchesMemmemOnRepetitiveInput) {
+    // Every position is a first/last byte candidate, only memcmp tells them
+    // apart.
+    for (size_t period : {1u, 2u, 3u, 7u, 16u, 17u}) {
+        std::string unit;
+        for (size_t i = 0; i < period; i++) unit += static_cast<char>('a' + i % 3);
+        std::string str;
+        while (str.size() < 200) str += unit;
+        for (size_t pat_len = 1; pat_len <= 40; pat_len++) {
+            expect_search(str, str.substr(5, pat_len));
+            std::string miss = str.substr(5, pat_len);
+            miss[pat_len / 2] = 'z';
+            expect_search(str, miss);
+        }
+    }
+}
+
+TEST(AcScanTest, FindsFirstOccurrences) {
+    std::string data = std::string(1000, '\0') + VER_STR "BOOT.XF.2.1-1" + std::string(500, 'Q') +
+                       VER_STR "TZ.XF.5.0-1" + VER_STR "TZ.again";
+    EXPECT_EQ(scan(data, kXblPatterns), expected_scan(data, kXblPatterns));
+}
+
+TEST(AcScanTest, MissingPattern) {
+    std::string data = std::string(4096, 'Q') + VER_STR "TZ.XF.5.0-1";
+    auto ends = scan(data, kXblPatterns);
+    EXPECT_EQ(ends, expected_scan(data, kXblPatterns));
+    EXPECT_EQ(ends[1], -1);
+}
+
+TEST(AcScanTest, MatchesAcrossChunkBoundaries) {
+    const std::string pat = VER_STR "BOOT.XF.";
+    for (size_t chunk = 1; chunk <= 2; chunk++) {
+        for (size_t split = 0; split <= pat.size(); split++) {
+            SCOPED_TRACE("chunk " + std::to_string(chunk) + " split " + std::to_string(split));
+            // Filled with near misses, so the automaton is rarely at its root.
+            std::string data;
+            while (data.size() < chunk * SCAN_CHUNK_LEN + 4096) data += "QC_IMAGE_VERSION_STRING";
+            data.replace(chunk * SCAN_CHUNK_LEN - split, pat.size(), pat);
+            data.replace(chunk * SCAN_CHUNK_LEN + 2048, 25, VER_STR "TZ.");
+            EXPECT_EQ(scan(data, kXblPatterns), expected_scan(data, kXblPatterns));
+        }
+    }
+}
+
+TEST(AcScanTest, MatchesMemmemOnRandomInput) {
+    std::mt19937 rng(48);
+    const std::vector<const char*> pats = {"abab", "abba", "abbb"};
+    for (int round = 0; round < 20; round++) {
+        std::string data =
+                random_string(&rng, SCAN_CHUNK_LEN + 1 + rng() % SCAN_CHUNK_LEN, 2 + round % 3);
+        // Keep the earliest matches away from the start, often past a chunk.
+        for (size_t i = 0; i < data.size() / 3 * 2; i++) {
+            if (data[i] == 'a') data[i] = 'c';
+        }
+        EXPECT_EQ(scan(data, pats), expected_scan(data, pats)) << "round " << round;
+    }
+}
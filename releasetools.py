@@ -27,11 +27,11 @@ def IncrementalOTA_InstallEnd(info):
   return
 
 def FullOTA_Assertions(info):
-  AddTrustZoneAssertion(info, info.input_zip)
+  AddFirmwareAssertions(info, info.input_zip)
   return
 
 def IncrementalOTA_Assertions(info):
-  AddTrustZoneAssertion(info, info.target_zip)
+  AddFirmwareAssertions(info, info.target_zip)
   return
 
 def AddImage(info, basename, dest):
@@ -49,12 +49,25 @@ def OTA_InstallEnd(info):
   AddImage(info, "vbmeta.img", "/dev/block/bootdevice/by-name/vbmeta")
   return
 
-def AddTrustZoneAssertion(info, input_zip):
-  android_info = info.input_zip.read("OTA/android-info.txt")
-  m = re.search(r'require\s+version-trustzone\s*=\s*(\S+)'.encode('utf-8'), android_info)
-  if m:
-    versions = m.group(1).split('|')
-    if len(versions) and '*' not in versions:
-      cmd = 'assert(xiaomi.verify_trustzone(' + ','.join(['"%s"' % tz for tz in versions]) + ') == "1" || abort("ERROR: This package requires firmware from an Android 10 based MIUI build. Please upgrade firmware and retry!"););'
-      info.script.AppendExtra(cmd)
+# android-info.txt requirement -> recovery updater verifier. Images in the
+# same partition are read in a single pass, and each partition only once.
+FIRMWARE_VERIFIERS = [
+  ("trustzone", "xiaomi.verify_trustzone"),
+  ("xbl", "xiaomi.verify_xbl"),
+  ("abl", "xiaomi.verify_abl"),
+  ("modem", "xiaomi.verify_modem"),
+  ("dsp", "xiaomi.verify_dsp"),
+  ("bluetooth", "xiaomi.verify_bluetooth"),
+  ("devcfg", "xiaomi.verify_devcfg"),
+]
+
+def AddFirmwareAssertions(info, input_zip):
+  android_info = input_zip.read("OTA/android-info.txt").decode('utf-8')
+  for image, verifier in FIRMWARE_VERIFIERS:
+    m = re.search(r'require\s+version-%s\s*=\s*(\S+)' % image, android_info)
+    if m:
+      versions = m.group(1).split('|')
+      if len(versions) and '*' not in versions:
+        cmd = 'assert(' + verifier + '(' + ','.join(['"%s"' % v for v in versions]) + ') == "1" || abort("ERROR: This package requires ' + image + ' firmware from an Android 10 based MIUI build. Please upgrade firmware and retry!"););'
+        info.script.AppendExtra(cmd)
   return
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares zram compressors on captured anonymous pages, to back the per
+// RAM tier choice in init_raphael.cpp. Samples are raw page dumps, e.g.
+//
+//   adb shell su -c 'dd if=/dev/block/zram0 bs=4096 count=65536' > sample.bin
+//
+// taken after a few minutes of real use. Like zram, pages are compressed one
+// by one and pages filled with a single repeated word are skipped.
+//
+// Usage: zram_bench <sample>...
+
+#include <lz4.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+// zram's zstd backend uses the default level.
+constexpr int kZstdLevel = 3;
+
+using Clock = std::chrono::steady_clock;
+
+struct Compressor {
+    const char* name;
+    size_t (*compress)(const char* src, char* dst, size_t dst_size);
+    bool (*decompress)(const char* src, size_t src_size, char* dst);
+};
+
+const Compressor kCompressors[] = {
+        {"lz4",
+         [](const char* src, char* dst, size_t dst_size) -> size_t {
+             int len = LZ4_compress_default(src, dst, kPageSize, dst_size);
+             return len > 0 ? len : 0;
+         },
+         [](const char* src, size_t src_size, char* dst) {
+             return LZ4_decompress_safe(src, dst, src_size, kPageSize) == kPageSize;
+         }},
+        {"zstd",
+         [](const char* src, char* dst, size_t dst_size) -> size_t {
+             size_t len = ZSTD_compress(dst, dst_size, src, kPageSize, kZstdLevel);
+             return ZSTD_isError(len) ? 0 : len;
+         },
+         [](const char* src, size_t src_size, char* dst) {
+             return ZSTD_decompress(dst, kPageSize, src, src_size) == kPageSize;
+         }},
+};
+
+// zram keeps these as just the repeated word, see page_same_filled().
+bool isSameFilled(const char* page) {
+    return !memcmp(page, page + sizeof(uint64_t), kPageSize - sizeof(uint64_t));
+}
+
+void run(const Compressor& c, const std::vector<const char*>& pages) {
+    size_t bound = std::max<size_t>(LZ4_compressBound(kPageSize), ZSTD_compressBound(kPageSize));
+    std::vector<char> out(pages.size() * bound);
+    std::vector<size_t> sizes(pages.size());
+    std::vector<char> page(kPageSize);
+
+    auto start = Clock::now();
+    size_t stored = 0;
+    for (size_t i = 0; i < pages.size(); i++) {
+        sizes[i] = c.compress(pages[i], &out[i * bound], bound);
+        // zram stores incompressible pages as is.
+        stored += sizes[i] && sizes[i] < kPageSize ? sizes[i] : kPageSize;
+    }
+    auto compressed = Clock::now();
+
+    size_t failed = 0;
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (!sizes[i]) continue;
+        if (!c.decompress(&out[i * bound], sizes[i], page.data()) ||
+            memcmp(page.data(), pages[i], kPageSize)) {
+            failed++;
+        }
+    }
+    auto decompressed = Clock::now();
+
+    auto mbps = [&](Clock::duration d) {
+        double s = std::chrono::duration<double>(d).count();
+        return s > 0 ? pages.size() * kPageSize / s / (1024 * 1024) : 0;
+    };
+    printf("%-5s ratio %.2f  compress %7.1f MB/s  decompress %7.1f MB/s%s\n", c.name,
+           static_cast<double>(pages.size() * kPageSize) / stored, mbps(compressed - start),
+           mbps(decompressed - compressed), failed ? "  ROUNDTRIP FAILED" : "");
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <sample>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> samples;
+    std::vector<const char*> pages;
+    size_t same_filled = 0;
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", argv[i]);
+            return 1;
+        }
+        samples.emplace_back(std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>());
+    }
+    for (const auto& sample : samples) {
+        for (size_t off = 0; off + kPageSize <= sample.size(); off += kPageSize) {
+            if (isSameFilled(&sample[off])) {
+                same_filled++;
+                continue;
+            }
+            pages.push_back(&sample[off]);
+        }
+    }
+
+    printf("%zu pages, %zu same-filled pages skipped\n", pages.size(), same_filled);
+    if (pages.empty()) return 1;
+    for (const auto& c : kCompressors) run(c, pages);
+    return 0;
+}